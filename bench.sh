@@ -0,0 +1,103 @@
+#!/bin/bash
+
+# Escenario de rendimiento de punta a punta: genera la base con el generador, la valida,
+# la sirve con cada modo de durabilidad y la carga con el cliente en modo --bench.
+# Todo se genera en un directorio temporal: el output.csv del directorio actual no se toca.
+# Los parámetros se pueden cambiar por variables de entorno, por ejemplo:
+#   REGISTROS=1000000 DURACION=30 MODOS="grupo" ./bench.sh
+
+GENERADORES=${GENERADORES:-4}
+REGISTROS=${REGISTROS:-200000}
+PUERTO=${PUERTO:-9400}
+CONEXIONES=${CONEXIONES:-8}
+DURACION=${DURACION:-10}
+MEZCLA=${MEZCLA:-get=70,update=10,add=10,delete=5,tx=5}
+MODOS=${MODOS:-"ninguna fsync grupo"}
+RESULTADOS=${RESULTADOS:-bench_resultados.txt}
+TRABAJO=$(mktemp -d "${TMPDIR:-/tmp}/bench.XXXXXX") || exit 1
+GENERADO="$TRABAJO/output.csv"
+BASE="$TRABAJO/bench.csv"
+TUBERIA="$TRABAJO/bench.stdin"
+
+# Segundos transcurridos desde una marca tomada con `date +%s.%N`.
+segundos_desde() {
+    awk -v inicio="$1" -v fin="$(date +%s.%N)" 'BEGIN { printf "%.3f", fin - inicio }'
+}
+
+limpiar() {
+    exec 3>&- 2>/dev/null
+    [ -n "$PID_SERVIDOR" ] && kill "$PID_SERVIDOR" 2>/dev/null
+    rm -rf "$TRABAJO"
+}
+trap limpiar EXIT
+
+for programa in generador validador servidor cliente; do
+    if [ ! -x "./$programa" ]; then
+        echo "Error: Falta ./$programa. Compile con 'make' antes de ejecutar el benchmark."
+        exit 1
+    fi
+done
+
+{
+    echo "========================================="
+    echo "Benchmark $(date '+%Y-%m-%d %H:%M:%S')"
+    echo "Versión: $(git rev-parse --short HEAD 2>/dev/null || echo desconocida)"
+    echo "Equipo: $(uname -srm), $(nproc) CPU"
+    echo "Parámetros: $GENERADORES generadores, $REGISTROS registros, $CONEXIONES conexiones, $DURACION s, $MEZCLA"
+} >> "$RESULTADOS"
+
+echo "[1/3] Generando $REGISTROS registros con $GENERADORES generadores..."
+inicio=$(date +%s.%N)
+# El generador siempre escribe output.csv en el directorio actual.
+if ! (cd "$TRABAJO" && "$OLDPWD/generador" "$GENERADORES" "$REGISTROS" > /dev/null); then
+    echo "Error: La generación falló."
+    exit 1
+fi
+echo "Generación: $(segundos_desde "$inicio") s" | tee -a "$RESULTADOS"
+
+echo "[2/3] Validando la base generada..."
+inicio=$(date +%s.%N)
+if ! ./validador "$GENERADO" > /dev/null; then
+    echo "Error: La validación falló."
+    exit 1
+fi
+echo "Validación: $(segundos_desde "$inicio") s" | tee -a "$RESULTADOS"
+
+echo "[3/3] Sirviendo y cargando con los modos: $MODOS"
+for modo in $MODOS; do
+    # Cada modo parte de la misma base recién generada, sin índice previo.
+    cp "$GENERADO" "$BASE"
+    rm -f "$TRABAJO"/bench.idx "$TRABAJO"/bench.log "$TUBERIA"
+    mkfifo "$TUBERIA"
+
+    inicio=$(date +%s.%N)
+    ./servidor "$PUERTO" "$CONEXIONES" "$CONEXIONES" --bd "$BASE" --durabilidad "$modo" < "$TUBERIA" > /dev/null &
+    PID_SERVIDOR=$!
+    # Mantiene abierta la entrada del servidor para poder enviarle CLOSE al terminar.
+    exec 3> "$TUBERIA"
+
+    # Espera a que el servidor acepte conexiones (incluye la construcción del índice).
+    listo=0
+    for _ in $(seq 1 600); do
+        if (exec 4<> "/dev/tcp/127.0.0.1/$PUERTO") 2>/dev/null; then
+            listo=1
+            break
+        fi
+        sleep 0.1
+    done
+    if [ "$listo" -ne 1 ]; then
+        echo "Error: El servidor no respondió en el puerto $PUERTO (modo $modo)."
+        exit 1
+    fi
+    echo "[$modo] Arranque del servidor: $(segundos_desde "$inicio") s" | tee -a "$RESULTADOS"
+
+    ./cliente 127.0.0.1 "$PUERTO" --bench -c "$CONEXIONES" -d "$DURACION" -m "$MEZCLA" -i "$REGISTROS" \
+        | sed "s/^/[$modo] /" | tee -a "$RESULTADOS"
+
+    echo "CLOSE" >&3
+    exec 3>&-
+    wait "$PID_SERVIDOR"
+    PID_SERVIDOR=""
+done
+
+echo "Resultados agregados a $RESULTADOS."
@@ -6,33 +6,22 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "histograma.h"
+#include "protocolo.h"
 
 #define TAMANIO_BUFFER 1024
+#define CONEXION_RECHAZADA -2 // El servidor respondió REJECT (lleno).
 
-// Función para leer una línea completa del socket.
-int leer_linea_del_socket(int socket, char* buffer, size_t tamanio) {
-    memset(buffer, 0, tamanio);
-    size_t total_leido = 0;
-    char c;
-    while (total_leido < tamanio - 1) {
-        int bytes_leidos = read(socket, &c, 1);
-        if (bytes_leidos <= 0) return bytes_leidos; // Error o conexión cerrada
-        buffer[total_leido++] = c;
-        if (c == '\n') break; // Fin de la línea, mensaje completo recibido
-    }
-    return total_leido;
-}
-
-int main(int argc, char *argv[]) {
-    // Valida que se hayan pasado la IP y el puerto como argumentos.
-    if (argc != 3) {
-        fprintf(stderr, "Uso: %s <IP_servidor> <puerto>\n", argv[0]);
-        return 1;
-    }
-
-    char *ip_servidor = argv[1];
-    int puerto = atoi(argv[2]);
-
+// Conecta con el servidor y espera la admisión (OK_CONNECT), pasando por la sala de
+// espera si hace falta. Devuelve el socket (ya asociado al lector), CONEXION_RECHAZADA si
+// el servidor está lleno o -1 ante un error. En modo silencioso solo informa errores.
+int conectar_servidor(const char* ip_servidor, int puerto, int silencioso, LectorSocket* lector) {
     int socket_cliente;
     struct sockaddr_in direccion_servidor;
     char buffer[TAMANIO_BUFFER];
@@ -41,7 +30,7 @@ int main(int argc, char *argv[]) {
     socket_cliente = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_cliente < 0) {
         perror("Error al crear el socket");
-        return 1;
+        return -1;
     }
 
     // 2. Preparar la dirección del servidor para la conexión.
@@ -51,7 +40,7 @@ int main(int argc, char *argv[]) {
     if (inet_pton(AF_INET, ip_servidor, &direccion_servidor.sin_addr) <= 0) {
         perror("Dirección IP inválida");
         close(socket_cliente);
-        return 1;
+        return -1;
     }
 
     // 3. Conectar al servidor.
@@ -64,32 +53,536 @@ int main(int argc, char *argv[]) {
             perror("Error en connect");
         }
         close(socket_cliente);
-        return 1;
+        return -1;
     }
 
     // 4. Esperar el mensaje inicial del servidor para saber nuestro estado.
-    int bytes_leidos = leer_linea_del_socket(socket_cliente, buffer, sizeof(buffer));
+    lector_inicializar(lector, socket_cliente);
+    int bytes_leidos = leer_linea(lector, buffer, sizeof(buffer));
     if (bytes_leidos <= 0) {
         printf("El servidor cerró la conexión inesperadamente.\n");
         close(socket_cliente);
-        return 1;
+        return -1;
     }
 
     if (strncmp(buffer, "REJECT", 6) == 0) {
-        printf("Servidor lleno. Intente mas tarde.\n");
+        if (!silencioso) printf("Servidor lleno. Intente mas tarde.\n");
         close(socket_cliente);
-        return 0;
+        return CONEXION_RECHAZADA;
     } else if (strncmp(buffer, "WAIT", 4) == 0) {
-        printf("Servidor lleno. En Espera...\n");
+        if (!silencioso) printf("Servidor lleno. En Espera...\n");
         // Nos quedamos esperando a que el servidor nos dé luz verde ("OK_CONNECT").
-        bytes_leidos = leer_linea_del_socket(socket_cliente, buffer, sizeof(buffer));
+        bytes_leidos = leer_linea(lector, buffer, sizeof(buffer));
         if (bytes_leidos <= 0 || strncmp(buffer, "OK_CONNECT", 10) != 0) {
             printf("No se pudo establecer la conexión final.\n");
             close(socket_cliente);
+            return -1;
+        }
+    }
+    return socket_cliente;
+}
+
+//--- MODO BENCHMARK ---//
+
+// Tipos de operación que puede generar el benchmark.
+enum { OP_GET, OP_UPDATE, OP_ADD, OP_DELETE, OP_TX, CANTIDAD_OPERACIONES };
+const char* NOMBRES_OPERACIONES[CANTIDAD_OPERACIONES] = { "GET", "UPDATE", "ADD", "DELETE", "TX" };
+
+// Espera antes de reintentar una operación rechazada por una transacción activa. Se
+// duplica en cada rechazo consecutivo hasta el máximo, con una parte al azar para que
+// las conexiones no reintenten todas a la vez.
+#define ESPERA_REINTENTO_MIN_US 100
+#define ESPERA_REINTENTO_MAX_US 10000
+
+// Resultado de ejecutar una operación.
+enum { RESULTADO_OK, RESULTADO_RECHAZO, RESULTADO_ERROR, RESULTADO_DESCONEXION };
+
+// Parámetros del benchmark.
+typedef struct {
+    int conexiones;
+    double duracion_segundos;
+    double operaciones_por_segundo; // 0 = a máxima velocidad.
+    int mezcla[CANTIDAD_OPERACIONES]; // Peso relativo de cada operación.
+    long cantidad_ids;              // Los GET/UPDATE/DELETE usan IDs en [0, cantidad_ids).
+    int escrituras_por_tx;
+} ConfiguracionBench;
+
+// Resultados de un proceso trabajador. Se ubican en memoria compartida para que el
+// proceso padre los combine al final.
+typedef struct {
+    Histograma latencias[CANTIDAD_OPERACIONES]; // Solo de operaciones completadas.
+    uint64_t rechazos[CANTIDAD_OPERACIONES]; // Respuestas de "transacción activa" (cada una se reintenta).
+    uint64_t errores[CANTIDAD_OPERACIONES];  // Otras respuestas ERROR|.
+    int conectado;                           // 1 conectado, 0 error, -1 rechazado.
+    int desconectado;                        // El servidor cerró la conexión durante la prueba.
+} ResultadosTrabajador;
+
+// Muestra cómo usar el programa.
+void mostrar_ayuda(const char* nombre_programa) {
+    fprintf(stderr, "Uso: %s <IP_servidor> <puerto> [--bench [opciones] | --batch <archivo|-> [-w <ventana>]]\n", nombre_programa);
+    fprintf(stderr, "Opciones de --bench:\n");
+    fprintf(stderr, "  -c <conexiones>     Conexiones concurrentes (por defecto 4)\n");
+    fprintf(stderr, "  -d <segundos>       Duración de la prueba (por defecto 10)\n");
+    fprintf(stderr, "  -r <ops/s>          Tasa objetivo total; 0 = máxima velocidad (por defecto 0)\n");
+    fprintf(stderr, "  -m <mezcla>         Pesos por operación (por defecto get=70,update=10,add=10,delete=5,tx=5)\n");
+    fprintf(stderr, "  -i <cantidad_ids>   Rango de IDs consultados/modificados (por defecto 1000)\n");
+    fprintf(stderr, "  -t <escrituras>     Escrituras por transacción tx (por defecto 5)\n");
+    fprintf(stderr, "Las operaciones rechazadas por una transacción activa se reintentan con espera creciente;\n");
+    fprintf(stderr, "throughput y percentiles cuentan solo las completadas.\n");
+    fprintf(stderr, "--batch envía los comandos del archivo (o de stdin con -) con hasta <ventana> en vuelo (por defecto 32).\n");
+    fprintf(stderr, "Ejemplos: %s 127.0.0.1 8080 --bench -c 8 -d 30 -r 2000 -m get=90,tx=10\n", nombre_programa);
+    fprintf(stderr, "          %s 127.0.0.1 8080 --batch mantenimiento.txt -w 64\n", nombre_programa);
+}
+
+// Interpreta una mezcla "get=70,update=10,...". Devuelve 0 si no es válida.
+int parsear_mezcla(const char* texto, int mezcla[CANTIDAD_OPERACIONES]) {
+    char copia[TAMANIO_BUFFER];
+    snprintf(copia, sizeof(copia), "%s", texto);
+    memset(mezcla, 0, sizeof(int) * CANTIDAD_OPERACIONES);
+    int total = 0;
+    for (char* par = strtok(copia, ","); par != NULL; par = strtok(NULL, ",")) {
+        char nombre[16];
+        int peso;
+        if (sscanf(par, "%15[^=]=%d", nombre, &peso) != 2 || peso < 0) return 0;
+        int encontrado = 0;
+        for (int i = 0; i < CANTIDAD_OPERACIONES; i++) {
+            if (strcasecmp(nombre, NOMBRES_OPERACIONES[i]) == 0) {
+                mezcla[i] = peso;
+                encontrado = 1;
+            }
+        }
+        if (!encontrado) return 0;
+        total += peso;
+    }
+    return total > 0;
+}
+
+// Envía un comando y espera su respuesta de una línea.
+int enviar_comando(LectorSocket* lector, const char* comando, char* respuesta, size_t tamanio) {
+    if (!enviar_todo(lector->fd, comando, strlen(comando))) return RESULTADO_DESCONEXION;
+    if (leer_linea(lector, respuesta, tamanio) <= 0) return RESULTADO_DESCONEXION;
+    if (strncmp(respuesta, "ERROR|", 6) == 0) {
+        return strstr(respuesta, "bloqueada") ? RESULTADO_RECHAZO : RESULTADO_ERROR;
+    }
+    return RESULTADO_OK;
+}
+
+// Arma una escritura al azar (UPDATE, ADD o DELETE) respetando los pesos de la mezcla.
+void armar_escritura(int operacion, const ConfiguracionBench* config, unsigned int* semilla, char* comando, size_t tamanio) {
+    long id = rand_r(semilla) % config->cantidad_ids;
+    switch (operacion) {
+        case OP_UPDATE:
+            snprintf(comando, tamanio, "UPDATE %ld 2 %d\n", id, rand_r(semilla) % 100);
+            break;
+        case OP_ADD:
+            snprintf(comando, tamanio, "ADD Bench,%d,%d.%02d\n", rand_r(semilla) % 100, rand_r(semilla) % 2000, rand_r(semilla) % 100);
+            break;
+        default:
+            snprintf(comando, tamanio, "DELETE %ld\n", id);
+            break;
+    }
+}
+
+// Ejecuta una operación completa. Las escrituras requieren transacción, así que
+// UPDATE/ADD/DELETE se envían como BEGIN + escritura + COMMIT; TX agrupa varias.
+int ejecutar_operacion(LectorSocket* lector, int operacion, const ConfiguracionBench* config, unsigned int* semilla) {
+    char comando[TAMANIO_BUFFER];
+    char respuesta[TAMANIO_BUFFER];
+
+    if (operacion == OP_GET) {
+        snprintf(comando, sizeof(comando), "GET %ld\n", rand_r(semilla) % config->cantidad_ids);
+        return enviar_comando(lector, comando, respuesta, sizeof(respuesta));
+    }
+
+    int resultado = enviar_comando(lector, "BEGIN TRANSACTION\n", respuesta, sizeof(respuesta));
+    if (resultado != RESULTADO_OK) return resultado;
+
+    int escrituras = operacion == OP_TX ? config->escrituras_por_tx : 1;
+    int peso_escrituras = config->mezcla[OP_UPDATE] + config->mezcla[OP_ADD] + config->mezcla[OP_DELETE];
+    for (int i = 0; i < escrituras; i++) {
+        int tipo = operacion;
+        if (operacion == OP_TX) {
+            // Dentro de una transacción se eligen escrituras según sus pesos (UPDATE si no hay ninguno).
+            tipo = OP_UPDATE;
+            if (peso_escrituras > 0) {
+                int sorteo = rand_r(semilla) % peso_escrituras;
+                if (sorteo >= config->mezcla[OP_UPDATE]) tipo = OP_ADD;
+                if (sorteo >= config->mezcla[OP_UPDATE] + config->mezcla[OP_ADD]) tipo = OP_DELETE;
+            }
+        }
+        armar_escritura(tipo, config, semilla, comando, sizeof(comando));
+        int resultado_escritura = enviar_comando(lector, comando, respuesta, sizeof(respuesta));
+        if (resultado_escritura == RESULTADO_DESCONEXION) return resultado_escritura;
+        // Un ID inexistente no invalida la transacción; se informa como error de la operación.
+        if (resultado_escritura == RESULTADO_ERROR) resultado = RESULTADO_ERROR;
+    }
+
+    int resultado_commit = enviar_comando(lector, "COMMIT TRANSACTION\n", respuesta, sizeof(respuesta));
+    return resultado_commit != RESULTADO_OK ? resultado_commit : resultado;
+}
+
+// Lógica de cada conexión del benchmark.
+void ejecutar_trabajador(const char* ip_servidor, int puerto, const ConfiguracionBench* config, uint64_t fin_us, ResultadosTrabajador* resultados) {
+    LectorSocket lector;
+    int socket_cliente = conectar_servidor(ip_servidor, puerto, 1, &lector);
+    if (socket_cliente < 0) {
+        resultados->conectado = socket_cliente == CONEXION_RECHAZADA ? -1 : 0;
+        return;
+    }
+    resultados->conectado = 1;
+
+    unsigned int semilla = (unsigned int)(time(NULL) ^ getpid());
+    int peso_total = 0;
+    for (int i = 0; i < CANTIDAD_OPERACIONES; i++) peso_total += config->mezcla[i];
+
+    // Con tasa objetivo, cada conexión tiene su propia agenda de envíos. La latencia se mide
+    // desde el momento agendado, así las demoras del servidor no se ocultan al atrasar envíos.
+    uint64_t intervalo_us = 0;
+    if (config->operaciones_por_segundo > 0) {
+        intervalo_us = (uint64_t)(1e6 * config->conexiones / config->operaciones_por_segundo);
+    }
+    uint64_t proximo_envio = tiempo_actual_us();
+
+    while (true) {
+        uint64_t ahora = tiempo_actual_us();
+        if (intervalo_us > 0) {
+            if (proximo_envio >= fin_us) break;
+            if (proximo_envio > ahora) usleep((useconds_t)(proximo_envio - ahora));
+        } else if (ahora >= fin_us) {
+            break;
+        }
+        uint64_t inicio = intervalo_us > 0 ? proximo_envio : ahora;
+
+        // Sortea la operación según los pesos de la mezcla.
+        int sorteo = rand_r(&semilla) % peso_total;
+        int operacion = 0;
+        while (sorteo >= config->mezcla[operacion]) sorteo -= config->mezcla[operacion++];
+
+        // Un rechazo por transacción activa se reintenta hasta que la operación se complete
+        // (o termine la prueba). La latencia incluye esa espera: es la que ve un cliente.
+        int resultado;
+        uint64_t espera_us = ESPERA_REINTENTO_MIN_US;
+        while ((resultado = ejecutar_operacion(&lector, operacion, config, &semilla)) == RESULTADO_RECHAZO) {
+            resultados->rechazos[operacion]++;
+            if (tiempo_actual_us() + espera_us >= fin_us) break;
+            usleep((useconds_t)(espera_us + rand_r(&semilla) % espera_us));
+            if (espera_us < ESPERA_REINTENTO_MAX_US) espera_us *= 2;
+        }
+        if (resultado == RESULTADO_DESCONEXION) {
+            resultados->desconectado = 1;
+            break;
+        }
+        if (resultado == RESULTADO_OK) histograma_registrar(&resultados->latencias[operacion], tiempo_actual_us() - inicio);
+        if (resultado == RESULTADO_ERROR) resultados->errores[operacion]++;
+        proximo_envio += intervalo_us;
+    }
+
+    write(socket_cliente, "EXIT\n", 5);
+    close(socket_cliente);
+}
+
+// Modo --bench: abre varias conexiones concurrentes (un proceso por conexión), genera
+// la mezcla de operaciones configurada e informa throughput y percentiles de latencia.
+int ejecutar_benchmark(const char* nombre_programa, const char* ip_servidor, int puerto, int argc, char* argv[]) {
+    ConfiguracionBench config = {
+        .conexiones = 4, .duracion_segundos = 10, .operaciones_por_segundo = 0,
+        .mezcla = { 70, 10, 10, 5, 5 }, .cantidad_ids = 1000, .escrituras_por_tx = 5
+    };
+    for (int i = 0; i < argc; i++) {
+        int valido = i + 1 < argc;
+        if (valido && strcmp(argv[i], "-c") == 0) valido = (config.conexiones = atoi(argv[++i])) > 0;
+        else if (valido && strcmp(argv[i], "-d") == 0) valido = (config.duracion_segundos = atof(argv[++i])) > 0;
+        else if (valido && strcmp(argv[i], "-r") == 0) valido = (config.operaciones_por_segundo = atof(argv[++i])) >= 0;
+        else if (valido && strcmp(argv[i], "-m") == 0) valido = parsear_mezcla(argv[++i], config.mezcla);
+        else if (valido && strcmp(argv[i], "-i") == 0) valido = (config.cantidad_ids = atol(argv[++i])) > 0;
+        else if (valido && strcmp(argv[i], "-t") == 0) valido = (config.escrituras_por_tx = atoi(argv[++i])) > 0;
+        else valido = 0;
+        if (!valido) {
+            mostrar_ayuda(nombre_programa);
             return 1;
         }
     }
 
+    size_t tamanio_resultados = sizeof(ResultadosTrabajador) * config.conexiones;
+    ResultadosTrabajador* resultados = mmap(NULL, tamanio_resultados, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (resultados == MAP_FAILED) {
+        perror("mmap de resultados");
+        return 1;
+    }
+
+    printf("Benchmark: %d conexiones, %.1f s, objetivo %s.\n", config.conexiones, config.duracion_segundos,
+           config.operaciones_por_segundo > 0 ? "con tasa fija" : "a máxima velocidad");
+    fflush(stdout);
+
+    uint64_t inicio_us = tiempo_actual_us();
+    uint64_t fin_us = inicio_us + (uint64_t)(config.duracion_segundos * 1e6);
+    for (int i = 0; i < config.conexiones; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            ejecutar_trabajador(ip_servidor, puerto, &config, fin_us, &resultados[i]);
+            exit(0);
+        } else if (pid < 0) {
+            perror("fork");
+            config.conexiones = i;
+            break;
+        }
+    }
+    while (wait(NULL) > 0) {}
+    double segundos = (double)(tiempo_actual_us() - inicio_us) / 1e6;
+
+    // Combina los resultados de todos los trabajadores.
+    Histograma* totales = calloc(CANTIDAD_OPERACIONES + 1, sizeof(Histograma));
+    if (!totales) {
+        munmap(resultados, tamanio_resultados);
+        return 1;
+    }
+    uint64_t rechazos[CANTIDAD_OPERACIONES] = {0}, errores[CANTIDAD_OPERACIONES] = {0};
+    uint64_t total_rechazos = 0, total_errores = 0;
+    int conectados = 0, rechazados = 0, desconectados = 0;
+    for (int i = 0; i < config.conexiones; i++) {
+        if (resultados[i].conectado == 1) conectados++;
+        if (resultados[i].conectado == -1) rechazados++;
+        desconectados += resultados[i].desconectado;
+        for (int op = 0; op < CANTIDAD_OPERACIONES; op++) {
+            histograma_combinar(&totales[op], &resultados[i].latencias[op]);
+            histograma_combinar(&totales[CANTIDAD_OPERACIONES], &resultados[i].latencias[op]);
+            rechazos[op] += resultados[i].rechazos[op];
+            errores[op] += resultados[i].errores[op];
+            total_rechazos += resultados[i].rechazos[op];
+            total_errores += resultados[i].errores[op];
+        }
+    }
+
+    const Histograma* total = &totales[CANTIDAD_OPERACIONES];
+    printf("Conexiones: %d establecidas, %d rechazadas, %d cortadas por el servidor.\n", conectados, rechazados, desconectados);
+    // Throughput y percentiles cuentan solo operaciones completadas; los rechazos (que se
+    // reintentan) y los errores se informan aparte.
+    printf("Operaciones completadas: %llu en %.2f s (%.1f ops/s). Rechazos por transacción activa (reintentados): %llu. Otros errores: %llu.\n",
+           (unsigned long long)total->cantidad, segundos, (double)total->cantidad / segundos,
+           (unsigned long long)total_rechazos, (unsigned long long)total_errores);
+    printf("%-8s %10s %9s %8s %9s %9s %9s %9s\n", "Op", "Completas", "Rechazos", "Errores", "p50_us", "p99_us", "p999_us", "max_us");
+    for (int op = 0; op <= CANTIDAD_OPERACIONES; op++) {
+        const Histograma* h = &totales[op];
+        if (op < CANTIDAD_OPERACIONES && h->cantidad + rechazos[op] + errores[op] == 0) continue;
+        printf("%-8s %10llu %9llu %8llu %9llu %9llu %9llu %9llu\n",
+               op < CANTIDAD_OPERACIONES ? NOMBRES_OPERACIONES[op] : "TOTAL",
+               (unsigned long long)h->cantidad,
+               (unsigned long long)(op < CANTIDAD_OPERACIONES ? rechazos[op] : total_rechazos),
+               (unsigned long long)(op < CANTIDAD_OPERACIONES ? errores[op] : total_errores),
+               (unsigned long long)histograma_percentil(h, 0.5), (unsigned long long)histograma_percentil(h, 0.99),
+               (unsigned long long)histograma_percentil(h, 0.999), (unsigned long long)h->max_us);
+    }
+
+    free(totales);
+    munmap(resultados, tamanio_resultados);
+    return conectados > 0 ? 0 : 1;
+}
+
+//--- MODO LOTE ---//
+
+// Buffer de salida del modo lote: junta varios comandos en un solo write().
+typedef struct {
+    int fd;
+    char datos[TAMANIO_LECTOR];
+    size_t largo;
+} BufferEnvio;
+
+bool envio_vaciar(BufferEnvio* envio) {
+    bool ok = enviar_todo(envio->fd, envio->datos, envio->largo);
+    envio->largo = 0;
+    return ok;
+}
+
+bool envio_agregar(BufferEnvio* envio, const char* linea) {
+    size_t largo = strlen(linea);
+    if (envio->largo + largo > sizeof(envio->datos) && !envio_vaciar(envio)) return false;
+    if (largo > sizeof(envio->datos)) return enviar_todo(envio->fd, linea, largo);
+    memcpy(envio->datos + envio->largo, linea, largo);
+    envio->largo += largo;
+    return true;
+}
+
+// Lee la próxima línea del archivo de comandos y la deja terminada en '\n' (sin '\r').
+// Las líneas que no entran en el buffer se omiten completas con un aviso, en lugar de
+// enviarlas cortadas. Devuelve false al llegar al final.
+bool leer_linea_lote(FILE* entrada, char* linea, size_t tamanio) {
+    while (fgets(linea, tamanio, entrada) != NULL) {
+        size_t largo = strcspn(linea, "\r\n");
+        if (linea[largo] == '\0' && largo == tamanio - 1) {
+            fprintf(stderr, "Línea de más de %zu caracteres omitida.\n", tamanio - 2);
+            int caracter;
+            while ((caracter = fgetc(entrada)) != EOF && caracter != '\n') { }
+            continue;
+        }
+        linea[largo] = '\n';
+        linea[largo + 1] = '\0';
+        return true;
+    }
+    return false;
+}
+
+// Lee la próxima línea de comando del archivo, omitiendo líneas vacías y comentarios (#).
+// Devuelve false al llegar al final.
+bool leer_comando_lote(FILE* entrada, char* comando, size_t tamanio) {
+    while (leer_linea_lote(entrada, comando, tamanio)) {
+        if (comando[0] == '\n' || comando[0] == '#') continue;
+        return true;
+    }
+    return false;
+}
+
+// Modo --batch: envía los comandos de un archivo (o de stdin con "-") manteniendo hasta
+// <ventana> comandos en vuelo. El servidor responde en orden, así que cada respuesta se
+// asocia al comando pendiente más antiguo. Devuelve 1 si alguna respuesta fue un error.
+int ejecutar_lote(const char* nombre_programa, const char* ip_servidor, int puerto, int argc, char* argv[]) {
+    if (argc < 1) {
+        mostrar_ayuda(nombre_programa);
+        return 1;
+    }
+    int ventana = 32;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc && (ventana = atoi(argv[++i])) > 0) continue;
+        mostrar_ayuda(nombre_programa);
+        return 1;
+    }
+    FILE* entrada = strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "r");
+    if (!entrada) {
+        perror("No se pudo abrir el archivo de comandos");
+        return 1;
+    }
+
+    LectorSocket lector;
+    int socket_cliente = conectar_servidor(ip_servidor, puerto, 1, &lector);
+    if (socket_cliente < 0) {
+        if (socket_cliente == CONEXION_RECHAZADA) fprintf(stderr, "Servidor lleno. Intente mas tarde.\n");
+        if (entrada != stdin) fclose(entrada);
+        return 1;
+    }
+
+    // Cola circular con el texto de los comandos en vuelo, para mostrarlo junto a su respuesta.
+    char (*pendientes)[TAMANIO_BUFFER] = malloc((size_t)ventana * TAMANIO_BUFFER);
+    BufferEnvio* envio = malloc(sizeof(BufferEnvio));
+    if (!pendientes || !envio) {
+        perror("malloc");
+        free(pendientes); free(envio);
+        close(socket_cliente);
+        if (entrada != stdin) fclose(entrada);
+        return 1;
+    }
+    envio->fd = socket_cliente;
+    envio->largo = 0;
+
+    char comando[TAMANIO_BUFFER];
+    char respuesta[TAMANIO_BUFFER];
+    int primero = 0, en_vuelo = 0;
+    long enviados = 0, errores = 0;
+    bool fin_entrada = false, conexion_ok = true;
+    bool comando_guardado = false; // `comando` ya tiene un BULK ADD leído que espera su turno.
+    uint64_t inicio_us = tiempo_actual_us();
+
+    while (conexion_ok) {
+        bool esperar_todas = false;
+        // 1. Completa la ventana con los próximos comandos y los envía juntos.
+        while (!fin_entrada && en_vuelo < ventana) {
+            if (!comando_guardado && !leer_comando_lote(entrada, comando, sizeof(comando))) {
+                fin_entrada = true;
+                break;
+            }
+            // El cuerpo de un BULK ADD puede ser enorme y se envía sin leer respuestas: si
+            // antes hay un SCAN o STATS en vuelo, el servidor quedaría bloqueado enviando filas
+            // que nadie lee y dejaría de leer el lote. Primero se reciben todas las respuestas.
+            comando_guardado = strncmp(comando, "BULK ADD", 8) == 0 && en_vuelo > 0;
+            if (comando_guardado) {
+                esperar_todas = true;
+                break;
+            }
+            snprintf(pendientes[(primero + en_vuelo) % ventana], TAMANIO_BUFFER, "%.*s", (int)strcspn(comando, "\n"), comando);
+            en_vuelo++;
+            enviados++;
+            conexion_ok = envio_agregar(envio, comando);
+            if (strncmp(comando, "EXIT", 4) == 0) fin_entrada = true;
+            // Las filas de un BULK ADD viajan con su comando; el servidor responde una sola vez.
+            if (strncmp(comando, "BULK ADD", 8) == 0) {
+                bool fin_lote = false;
+                while (conexion_ok && leer_linea_lote(entrada, comando, sizeof(comando))) {
+                    conexion_ok = envio_agregar(envio, comando);
+                    if (strcmp(comando, "END\n") == 0) {
+                        fin_lote = true;
+                        break;
+                    }
+                }
+                if (!fin_lote && conexion_ok) conexion_ok = envio_agregar(envio, "END\n");
+            }
+        }
+        if (conexion_ok) conexion_ok = envio_vaciar(envio);
+        if (!conexion_ok || en_vuelo == 0) break;
+
+        // 2. Lee todas las respuestas que ya llegaron (al menos una, bloqueando si hace falta),
+        //    o todas las pendientes si un BULK ADD espera para enviarse.
+        do {
+            if (leer_linea(&lector, respuesta, sizeof(respuesta)) <= 0) {
+                conexion_ok = false;
+                break;
+            }
+            const char* pendiente = pendientes[primero];
+            if (strncmp(respuesta, "ROW|", 4) == 0 || strncmp(respuesta, "END|", 4) == 0) {
+                printf("%s =>\n", pendiente);
+                while (strncmp(respuesta, "ROW|", 4) == 0) {
+                    printf("  %s\n", respuesta + 4);
+                    if (leer_linea(&lector, respuesta, sizeof(respuesta)) <= 0) {
+                        conexion_ok = false;
+                        break;
+                    }
+                }
+                if (conexion_ok) printf("  (%ld registros)\n", atol(respuesta + 4));
+            } else {
+                printf("%s => %s\n", pendiente, respuesta);
+                if (strncmp(respuesta, "ERROR|", 6) == 0) errores++;
+            }
+            primero = (primero + 1) % ventana;
+            en_vuelo--;
+        } while (conexion_ok && en_vuelo > 0 && (esperar_todas || lector_tiene_linea(&lector)));
+    }
+
+    double segundos = (double)(tiempo_actual_us() - inicio_us) / 1e6;
+    if (en_vuelo > 0) {
+        fprintf(stderr, "El servidor cerró la conexión con %d comandos sin respuesta.\n", en_vuelo);
+        errores += en_vuelo;
+    }
+    fprintf(stderr, "Lote: %ld comandos en %.3f s, %ld con error.\n", enviados, segundos, errores);
+
+    free(pendientes);
+    free(envio);
+    close(socket_cliente);
+    if (entrada != stdin) fclose(entrada);
+    return errores > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Valida que se hayan pasado la IP y el puerto como argumentos.
+    if (argc < 3 || (argc > 3 && strcmp(argv[3], "--bench") != 0 && strcmp(argv[3], "--batch") != 0)) {
+        mostrar_ayuda(argv[0]);
+        return 1;
+    }
+
+    char *ip_servidor = argv[1];
+    int puerto = atoi(argv[2]);
+    char buffer[TAMANIO_BUFFER];
+
+    // Modos no interactivos: generación de carga o lote de comandos.
+    if (argc > 3 && strcmp(argv[3], "--bench") == 0) {
+        return ejecutar_benchmark(argv[0], ip_servidor, puerto, argc - 4, argv + 4);
+    }
+    if (argc > 3) {
+        return ejecutar_lote(argv[0], ip_servidor, puerto, argc - 4, argv + 4);
+    }
+
+    LectorSocket lector;
+    int socket_cliente = conectar_servidor(ip_servidor, puerto, 0, &lector);
+    if (socket_cliente == CONEXION_RECHAZADA) return 0;
+    if (socket_cliente < 0) return 1;
+    int bytes_leidos;
+
     printf("Conectado al servidor. Escribe 'EXIT' para salir.\n");
     
     // 5. Bucle interactivo para enviar y recibir mensajes.
@@ -113,16 +606,50 @@ int main(int argc, char *argv[]) {
             break;
         }
 
+        // BULK ADD: las filas siguientes se envían sin esperar respuesta hasta la línea END.
+        if (strncmp(buffer, "BULK ADD", 8) == 0) {
+            int fin_enviado = 0;
+            while (fgets(buffer, sizeof(buffer), stdin) != NULL) {
+                if (write(socket_cliente, buffer, strlen(buffer)) < 0) {
+                    perror("Error al enviar datos");
+                    break;
+                }
+                // Solo una línea exactamente "END" cierra el lote, igual que en el servidor.
+                buffer[strcspn(buffer, "\r\n")] = '\0';
+                if (strcmp(buffer, "END") == 0) {
+                    fin_enviado = 1;
+                    break;
+                }
+            }
+            // Si la entrada terminó antes de END, cierra el lote igualmente.
+            if (!fin_enviado) write(socket_cliente, "END\n", 4);
+        }
+
         // Lee la respuesta completa del servidor.
-        bytes_leidos = leer_linea_del_socket(socket_cliente, buffer, sizeof(buffer));
+        bytes_leidos = leer_linea(&lector, buffer, sizeof(buffer));
         
         if (bytes_leidos <= 0) {
             printf("\nEl servidor cerró la conexión.\n");
             break;
         }
         
+        // Respuesta de varias filas: se muestran a medida que llegan hasta la marca END.
+        if (strncmp(buffer, "ROW|", 4) == 0 || strncmp(buffer, "END|", 4) == 0) {
+            while (strncmp(buffer, "ROW|", 4) == 0) {
+                printf("%s\n", buffer + 4);
+                bytes_leidos = leer_linea(&lector, buffer, sizeof(buffer));
+                if (bytes_leidos <= 0) break;
+            }
+            if (bytes_leidos <= 0) {
+                printf("\nEl servidor cerró la conexión.\n");
+                break;
+            }
+            printf("Servidor: %ld registros.\n", atol(buffer + 4));
+            continue;
+        }
+
         // Muestra la respuesta en la pantalla.
-        printf("Servidor: %s", buffer);
+        printf("Servidor: %s\n", buffer);
     }
 
     // 6. Cierra la conexión.
@@ -9,11 +9,17 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 //--- CONFIGURACIÓN PRINCIPAL ---//
 
 // Nombre del archivo de salida
 const char* NOMBRE_ARCHIVO_SALIDA = "output.csv"; 
+// Socket local del servidor al que se envían los registros (NULL = escribir el archivo)
+const char* RUTA_SOCKET_SERVIDOR = NULL;
+// Buffer de envío al servidor: agrupa muchos registros por cada write()
+#define TAMANIO_BUFFER_ENVIO (64 * 1024)
 // Cantidad de IDs que cada generador solicita a la vez
 const int TAMANIO_BLOQUE_IDS = 10;
 // Clave única para la memoria compartida (SHM)
@@ -60,7 +66,9 @@ int cantidad_hijos = 0;
 
 // Muestra cómo usar el programa
 void mostrar_ayuda(const char* nombre_programa) {
-    fprintf(stderr, "Uso: %s <cantidad_generadores> <total_registros>\n", nombre_programa);
+    fprintf(stderr, "Uso: %s <cantidad_generadores> <total_registros> [--servidor <ruta_socket>]\n", nombre_programa);
+    fprintf(stderr, "  --servidor <ruta_socket>  Envía los registros a un servidor iniciado con --ingesta\n");
+    fprintf(stderr, "                            en lugar de escribir %s\n", NOMBRE_ARCHIVO_SALIDA);
     fprintf(stderr, "Ejemplo: %s 5 1000\n", nombre_programa);
 }
 
@@ -106,6 +114,50 @@ void operar_semaforo(int id_semaforo, unsigned short indice_semaforo, short oper
     }
 }
 
+// Conecta con el socket de ingesta del servidor y lo envuelve en un FILE* con buffer
+// grande, para que el coordinador escriba los registros igual que en el archivo.
+FILE* conectar_servidor() {
+    struct sockaddr_un direccion;
+    memset(&direccion, 0, sizeof(direccion));
+    direccion.sun_family = AF_UNIX;
+    snprintf(direccion.sun_path, sizeof(direccion.sun_path), "%s", RUTA_SOCKET_SERVIDOR);
+
+    int socket_servidor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_servidor < 0) return NULL;
+    if (connect(socket_servidor, (struct sockaddr*)&direccion, sizeof(direccion)) < 0) {
+        close(socket_servidor);
+        return NULL;
+    }
+    FILE* flujo = fdopen(socket_servidor, "r+");
+    if (flujo == NULL) {
+        close(socket_servidor);
+        return NULL;
+    }
+    setvbuf(flujo, NULL, _IOFBF, TAMANIO_BUFFER_ENVIO);
+    return flujo;
+}
+
+// Cierra el flujo hacia el servidor: envía FIN y muestra su confirmación.
+void finalizar_envio(FILE* flujo) {
+    char respuesta[256];
+    fprintf(flujo, "FIN\n");
+    if (fflush(flujo) != 0) {
+        perror("envío al servidor");
+        exit(EXIT_FAILURE);
+    }
+    // Lectura directa del socket: el buffer del FILE* solo se usa para escribir.
+    ssize_t leidos = read(fileno(flujo), respuesta, sizeof(respuesta) - 1);
+    if (leidos <= 0) {
+        fprintf(stderr, "[Coordinador] El servidor no confirmó la ingesta.\n");
+        exit(EXIT_FAILURE);
+    }
+    respuesta[leidos] = '\0';
+    respuesta[strcspn(respuesta, "\r\n")] = '\0';
+    printf("[Coordinador] Servidor: %s\n", respuesta);
+    fclose(flujo);
+    if (strncmp(respuesta, "OK|", 3) != 0) exit(EXIT_FAILURE);
+}
+
 //--- LÓGICA DE LOS PROCESOS HIJOS ---//
 // Lógica del Proceso Coordinador (consumidor)
 void ejecutar_proceso_coordinador() {
@@ -119,12 +171,14 @@ void ejecutar_proceso_coordinador() {
         exit(EXIT_FAILURE);
     }
 
-    // Abre el archivo CSV en modo "append" para añadir registros
-    FILE* archivo_csv = fopen(NOMBRE_ARCHIVO_SALIDA, "a");
+    // Abre el archivo CSV en modo "append" para añadir registros, o el flujo hacia el
+    // servidor. En ese caso se envía primero la misma cabecera que tendría el archivo.
+    FILE* archivo_csv = RUTA_SOCKET_SERVIDOR ? conectar_servidor() : fopen(NOMBRE_ARCHIVO_SALIDA, "a");
     if (archivo_csv == NULL) {
-        perror("fopen en coordinador");
+        perror(RUTA_SOCKET_SERVIDOR ? "conexión con el servidor" : "fopen en coordinador");
         exit(EXIT_FAILURE);
     }
+    if (RUTA_SOCKET_SERVIDOR) fprintf(archivo_csv, "ID,NOMBRE_PRODUCTO,CANTIDAD,PRECIO\n");
 
     // Bucle principal: procesa exactamente la cantidad de registros esperada
     for (long i = 0; i < datos->total_registros_a_generar; ++i) {
@@ -141,7 +195,11 @@ void ejecutar_proceso_coordinador() {
 
     // Tareas finales del coordinador
     datos->coordinador_finalizo = true;
-    fclose(archivo_csv);
+    if (RUTA_SOCKET_SERVIDOR) {
+        finalizar_envio(archivo_csv);
+    } else {
+        fclose(archivo_csv);
+    }
     printf("[Coordinador] Finalizado. Total de registros: %ld\n", datos->total_registros_a_generar);
     shmdt(datos); // Desconecta la memoria compartida de este proceso
     exit(EXIT_SUCCESS);
@@ -211,7 +269,9 @@ void ejecutar_proceso_generador(int id_generador) {
 
 int main(int argc, char* argv[]) {
     // 1. Validar argumentos de entrada
-    if (argc != 3) {
+    if (argc == 5 && strcmp(argv[3], "--servidor") == 0) {
+        RUTA_SOCKET_SERVIDOR = argv[4];
+    } else if (argc != 3) {
         mostrar_ayuda(argv[0]);
         return 1;
     }
@@ -247,11 +307,13 @@ int main(int argc, char* argv[]) {
     semctl(id_semaforos, SEMAFORO_BUFFER_LLENO, SETVAL, 0);   // Vacío al inicio
     semctl(id_semaforos, SEMAFORO_BUFFER_VACIO, SETVAL, 1);   // Libre al inicio
     
-    // 3. Preparar el archivo de salida CSV
-    FILE* archivo_csv = fopen(NOMBRE_ARCHIVO_SALIDA, "w");
-    if (archivo_csv == NULL) return 1;
-    fprintf(archivo_csv, "ID,NOMBRE_PRODUCTO,CANTIDAD,PRECIO\n");
-    fclose(archivo_csv);
+    // 3. Preparar el archivo de salida CSV (al enviar al servidor, la cabecera la manda el coordinador)
+    if (RUTA_SOCKET_SERVIDOR == NULL) {
+        FILE* archivo_csv = fopen(NOMBRE_ARCHIVO_SALIDA, "w");
+        if (archivo_csv == NULL) return 1;
+        fprintf(archivo_csv, "ID,NOMBRE_PRODUCTO,CANTIDAD,PRECIO\n");
+        fclose(archivo_csv);
+    }
     
     // 4. Preparar la gestión de procesos hijos
     int total_hijos = cantidad_generadores + 1; // +1 por el coordinador
@@ -281,7 +343,14 @@ int main(int argc, char* argv[]) {
     // 6. Esperar a que todos los procesos hijos terminen
     printf("[PADRE] Esperando a que los %d procesos hijos finalicen...\n", cantidad_hijos);
     for (int i = 0; i < cantidad_hijos; ++i) {
-        wait(NULL);
+        int estado;
+        pid_t terminado = wait(&estado);
+        // Si el coordinador falla (por ejemplo, se perdió la conexión con el servidor),
+        // los generadores quedarían esperando el buffer para siempre.
+        if (terminado == pids_hijos[0] && !(WIFEXITED(estado) && WEXITSTATUS(estado) == 0)) {
+            fprintf(stderr, "[PADRE] El coordinador terminó con error. Deteniendo generadores.\n");
+            for (int j = 1; j < cantidad_hijos; j++) kill(pids_hijos[j], SIGTERM);
+        }
     }
     printf("[PADRE] Todos los procesos hijos han finalizado.\n");
     
@@ -0,0 +1,81 @@
+#ifndef HISTOGRAMA_H
+#define HISTOGRAMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Histograma log-lineal de latencias en microsegundos. Cada potencia de 2 se divide en
+// 8 sub-rangos, por lo que el error relativo de un percentil es menor al 12.5%.
+// Las operaciones son atómicas: la misma estructura puede vivir en memoria compartida
+// y ser actualizada por varios procesos sin bloqueos.
+#define HISTOGRAMA_SUB_BITS 3
+#define HISTOGRAMA_SUB (1 << HISTOGRAMA_SUB_BITS)
+#define HISTOGRAMA_BUCKETS ((64 - HISTOGRAMA_SUB_BITS + 1) * HISTOGRAMA_SUB)
+
+typedef struct {
+    uint64_t cantidad;
+    uint64_t suma_us;
+    uint64_t max_us;
+    uint64_t buckets[HISTOGRAMA_BUCKETS];
+} Histograma;
+
+// Tiempo monotónico actual en microsegundos.
+static inline uint64_t tiempo_actual_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// Índice del bucket correspondiente a un valor.
+static inline int histograma_bucket(uint64_t valor) {
+    if (valor < HISTOGRAMA_SUB) return (int)valor;
+    int exponente = 63 - __builtin_clzll(valor);
+    int sub = (int)((valor >> (exponente - HISTOGRAMA_SUB_BITS)) & (HISTOGRAMA_SUB - 1));
+    return (exponente - HISTOGRAMA_SUB_BITS + 1) * HISTOGRAMA_SUB + sub;
+}
+
+// Mayor valor que cae dentro de un bucket.
+static inline uint64_t histograma_limite_bucket(int bucket) {
+    if (bucket < HISTOGRAMA_SUB) return (uint64_t)bucket;
+    int exponente = bucket / HISTOGRAMA_SUB + HISTOGRAMA_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket % HISTOGRAMA_SUB);
+    return ((HISTOGRAMA_SUB + sub + 1) << (exponente - HISTOGRAMA_SUB_BITS)) - 1;
+}
+
+static inline void histograma_registrar(Histograma* h, uint64_t valor_us) {
+    __atomic_fetch_add(&h->cantidad, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->suma_us, valor_us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[histograma_bucket(valor_us)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+    while (valor_us > max && !__atomic_compare_exchange_n(&h->max_us, &max, valor_us, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+// Suma el contenido de un histograma a otro (por ejemplo, los de varios procesos).
+static inline void histograma_combinar(Histograma* destino, const Histograma* origen) {
+    destino->cantidad += origen->cantidad;
+    destino->suma_us += origen->suma_us;
+    if (origen->max_us > destino->max_us) destino->max_us = origen->max_us;
+    for (int i = 0; i < HISTOGRAMA_BUCKETS; i++) destino->buckets[i] += origen->buckets[i];
+}
+
+// Percentil aproximado (0 < p <= 1), expresado como límite superior de su bucket.
+static inline uint64_t histograma_percentil(const Histograma* h, double p) {
+    uint64_t total = __atomic_load_n(&h->cantidad, __ATOMIC_RELAXED);
+    if (total == 0) return 0;
+    // Rango de la muestra buscada, redondeado hacia arriba.
+    uint64_t objetivo = (uint64_t)(p * (double)total);
+    if ((double)objetivo < p * (double)total || objetivo == 0) objetivo++;
+    uint64_t acumulado = 0;
+    for (int i = 0; i < HISTOGRAMA_BUCKETS; i++) {
+        acumulado += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (acumulado >= objetivo) {
+            uint64_t limite = histograma_limite_bucket(i);
+            uint64_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+            return limite < max ? limite : max;
+        }
+    }
+    return __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+}
+
+#endif
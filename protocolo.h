@@ -0,0 +1,110 @@
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// Funciones de E/S del protocolo de texto compartidas por servidor y cliente.
+// Cada mensaje es una línea terminada en '\n'.
+
+#define TAMANIO_LECTOR (1024 * 8) // Buffer de recepción por conexión
+
+// Buffer de lectura de un socket. Permite procesar el flujo línea a línea con un
+// read() por bloque en lugar de uno por byte, aunque varias líneas lleguen juntas.
+typedef struct {
+    int fd;
+    char datos[TAMANIO_LECTOR];
+    size_t inicio;
+    size_t fin;
+} LectorSocket;
+
+static inline void lector_inicializar(LectorSocket* lector, int fd) {
+    lector->fd = fd;
+    lector->inicio = 0;
+    lector->fin = 0;
+}
+
+// Indica si ya hay una línea completa en el buffer (leerla no requiere una llamada al sistema).
+static inline bool lector_tiene_linea(const LectorSocket* lector) {
+    return memchr(lector->datos + lector->inicio, '\n', lector->fin - lector->inicio) != NULL;
+}
+
+// Lee una línea del socket usando el buffer del lector. Devuelve 1 si obtuvo una línea
+// (sin '\r' ni '\n'), 0 si el otro extremo cerró la conexión y -1 ante un error.
+// Las líneas más largas que el buffer de destino se truncan.
+static inline int leer_linea(LectorSocket* lector, char* linea, size_t tamanio) {
+    size_t largo = 0;
+    while (true) {
+        // Consume lo que ya está en el buffer hasta encontrar un fin de línea.
+        char* inicio = lector->datos + lector->inicio;
+        size_t disponibles = lector->fin - lector->inicio;
+        char* salto = memchr(inicio, '\n', disponibles);
+        size_t a_consumir = salto ? (size_t)(salto - inicio) : disponibles;
+        size_t a_copiar = a_consumir < tamanio - 1 - largo ? a_consumir : tamanio - 1 - largo;
+        memcpy(linea + largo, inicio, a_copiar);
+        largo += a_copiar;
+        lector->inicio += a_consumir;
+        if (salto) {
+            lector->inicio++; // Salta el '\n'.
+            linea[largo] = '\0';
+            if (largo > 0 && linea[largo - 1] == '\r') linea[largo - 1] = '\0';
+            return 1;
+        }
+        // Buffer agotado: lo rellena con una sola llamada a read().
+        ssize_t bytes_leidos = read(lector->fd, lector->datos, sizeof(lector->datos));
+        if (bytes_leidos < 0 && errno == EINTR) continue;
+        if (bytes_leidos <= 0) {
+            // Una última línea sin '\n' antes del cierre también se entrega.
+            if (bytes_leidos == 0 && largo > 0) {
+                linea[largo] = '\0';
+                return 1;
+            }
+            return bytes_leidos < 0 ? -1 : 0;
+        }
+        lector->inicio = 0;
+        lector->fin = (size_t)bytes_leidos;
+    }
+}
+
+// Copia exactamente `cantidad` bytes del socket a un descriptor (por ejemplo, un archivo
+// que sigue a una línea de cabecera). Usa primero lo que ya está en el buffer del lector.
+// Devuelve false si la conexión se cerró antes o falló una escritura.
+static inline bool lector_copiar_a_fd(LectorSocket* lector, int fd, uint64_t cantidad) {
+    while (cantidad > 0) {
+        if (lector->inicio == lector->fin) {
+            ssize_t bytes_leidos = read(lector->fd, lector->datos, sizeof(lector->datos));
+            if (bytes_leidos < 0 && errno == EINTR) continue;
+            if (bytes_leidos <= 0) return false;
+            lector->inicio = 0;
+            lector->fin = (size_t)bytes_leidos;
+        }
+        size_t disponibles = lector->fin - lector->inicio;
+        size_t a_copiar = disponibles < cantidad ? disponibles : (size_t)cantidad;
+        ssize_t escritos = write(fd, lector->datos + lector->inicio, a_copiar);
+        if (escritos < 0 && errno == EINTR) continue;
+        if (escritos <= 0) return false;
+        lector->inicio += (size_t)escritos;
+        cantidad -= (uint64_t)escritos;
+    }
+    return true;
+}
+
+// Escribe todo el buffer en el socket. send() se bloquea cuando el otro extremo no
+// consume, lo que limita lo que se retiene en memoria. Devuelve false si la conexión
+// se cerró o se superó el timeout de envío (SO_SNDTIMEO).
+static inline bool enviar_todo(int fd, const char* datos, size_t largo) {
+    while (largo > 0) {
+        ssize_t enviados = send(fd, datos, largo, MSG_NOSIGNAL);
+        if (enviados < 0 && errno == EINTR) continue;
+        if (enviados <= 0) return false;
+        datos += enviados;
+        largo -= (size_t)enviados;
+    }
+    return true;
+}
+
+#endif
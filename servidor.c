@@ -5,37 +5,266 @@
 #include <stdbool.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/file.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <netdb.h>
+#include <sys/sendfile.h>
+#include "histograma.h"
+#include "protocolo.h"
 
 #define TAMANIO_BUFFER 1024
 #define MAX_CLIENTES_TOTAL 256 // Límite máximo de conexiones que el servidor puede manejar
-const char* NOMBRE_ARCHIVO_BD = "output.csv";
+#define TAMANIO_BLOQUE_RESPUESTA (TAMANIO_BUFFER * 16) // Máximo de filas pendientes de envío por cliente
+#define TIMEOUT_ENVIO_SEGUNDOS 30 // Un cliente que no consume su respuesta en este tiempo se desconecta
+#define CAPACIDAD_INDICE (1L << 30) // IDs cubiertos por el índice primario (solo reserva memoria virtual)
+#define MAX_FILAS_LOTE_INGESTA 4096 // Filas que la ingesta escribe e indexa con un mismo bloqueo
+#define MAX_REPLICAS 8 // Réplicas conectadas a la vez
+#define INTERVALO_LATIDO_US 1000000 // Cada cuánto el primario anuncia su LSN a las réplicas
+#define ESPERA_CAMBIOS_US 10000 // Pausa del envío de cambios cuando no hay nada nuevo
+#define TAMANIO_BLOQUE_REPLICACION (64 * 1024) // Bytes del registro de cambios leídos por vez
+#define NOMBRE_ARCHIVO_BD_POR_DEFECTO "output.csv"
+const char* NOMBRE_ARCHIVO_BD = NOMBRE_ARCHIVO_BD_POR_DEFECTO;
 const char* NOMBRE_ARCHIVO_TEMP = "output.tmp";
+// Archivo sobre el que se toman los flock. No puede ser el CSV: cada UPDATE/DELETE lo
+// reemplaza por otro inodo y los clientes que lo abrieron antes bloquearían el viejo.
+const char* NOMBRE_ARCHIVO_BLOQUEO = "output.lock";
+// Snapshot del índice primario. Se mapea directamente, así un reinicio no recorre el CSV.
+const char* NOMBRE_ARCHIVO_INDICE = "output.idx";
+// Registro de cambios confirmados que se envía a las réplicas (solo con --replicacion).
+// Cada transacción agrega sus líneas "P|<fila>" (alta o modificación), "D|<ID>" (baja) o
+// "R|<cabecera>" (base reiniciada) seguidas de "C". El LSN es la posición en el registro
+// contando desde el arranque: el archivo se trunca cuando no hay réplicas conectadas, y
+// Metricas.registro_base guarda el LSN de su primer byte.
+const char* NOMBRE_ARCHIVO_CAMBIOS = "output.log";
+#define MAGIA_INDICE "CSVIDX\0\0"
+#define VERSION_INDICE 1
+#define TAMANIO_MUESTRA_SUMA (1024 * 1024) // Bytes del principio y del final del CSV que entran en la suma de control
+#define PROXIMO_ID_DESCONOCIDO (-1L)         // El índice no se pudo construir (ver construir_indice)
+#define ENTRADAS_TRAMO_INDICE 8192         // Entradas (64 KB) que construir_indice vuelca juntas
+
+// Modos de durabilidad de COMMIT TRANSACTION.
+enum {
+    DURABILIDAD_NINGUNA, // Solo libera el bloqueo; el sistema operativo escribe cuando quiere.
+    DURABILIDAD_FSYNC,   // fsync del CSV y del directorio en cada commit, con el bloqueo tomado.
+    DURABILIDAD_GRUPO    // Los commits cercanos en el tiempo comparten un mismo fsync.
+};
+int modo_durabilidad = DURABILIDAD_NINGUNA;
+long espera_grupo_us = 1000; // Máximo que el líder de un grupo espera a que se sumen más commits.
 
 // Estructura para gestionar los sockets de los clientes en espera.
 int sockets_en_espera[MAX_CLIENTES_TOTAL];
 int clientes_en_espera_app = 0;
 volatile sig_atomic_t clientes_activos = 0;
 
+// Índice primario compartido por todos los procesos: desplazamiento en bytes de cada
+// registro dentro del CSV, indexado por ID (0 = el ID no existe; la cabecera ocupa el
+// byte 0, así que ningún registro empieza ahí). Se protege con el mismo flock que el
+// archivo: se modifica con el bloqueo exclusivo y se consulta con el compartido.
+// Guarda la identidad del CSV que describe para detectar cambios hechos desde afuera
+// del servidor (por ejemplo, el generador escribiendo output.csv directamente).
+// La estructura es también el formato de output.idx: al cerrar ordenadamente se marca
+// como limpia y se etiqueta con el tamaño, la fecha de modificación y una suma de
+// control del CSV; el próximo inicio la usa tal cual si la etiqueta coincide.
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t limpio;      // 1 solo entre un cierre ordenado y el próximo inicio.
+    int64_t tamanio_csv;  // Etiqueta del CSV al guardar el snapshot.
+    int64_t mtime_ns;
+    uint64_t suma_csv;
+    long proximo_id; // Mayor ID visto + 1: es el contador de IDs de ADD y BULK ADD.
+                     // PROXIMO_ID_DESCONOCIDO si falló la última reconstrucción.
+    long registros;  // Registros indexados.
+    dev_t dispositivo;
+    ino_t inodo;
+    off_t tamanio;
+    off_t desplazamientos[];
+} IndicePrimario;
+
+IndicePrimario* indice = NULL;
+int fd_indice = -1; // -1 si el índice vive solo en memoria (no se pudo abrir output.idx).
+
+// Proceso que atiende la ingesta en curso desde el generador (0 si no hay ninguna).
+volatile pid_t pid_ingesta = 0;
+
+// Replicación en el primario: registro de cambios abierto antes de los fork() (con
+// O_APPEND, cada transacción se agrega con un único write) y los cambios de la
+// transacción en curso de este proceso, que se publican al confirmarla.
+int fd_registro_cambios = -1;
+char* cambios_pendientes = NULL;
+size_t cambios_largo = 0;
+size_t cambios_capacidad = 0;
+// Procesos que envían cambios a cada réplica conectada (0 = lugar libre).
+volatile pid_t pids_replicacion[MAX_REPLICAS];
+
+// Replicación en la réplica: "host:puerto" del primario y proceso que aplica sus cambios.
+const char* replica_de = NULL;
+volatile pid_t pid_aplicador = 0;
+
+// Respuesta de varias filas que se envía por bloques a medida que se genera.
+// Protocolo: una línea "ROW|<registro>" por fila y una línea final "END|<cantidad>".
+typedef struct {
+    int fd;
+    char datos[TAMANIO_BLOQUE_RESPUESTA];
+    size_t largo;
+    long filas;
+    bool error; // El cliente dejó de recibir; el resto de la respuesta se descarta.
+} RespuestaEnBloques;
+
+// Comandos con contadores y latencias propias en las métricas.
+enum {
+    COMANDO_GET, COMANDO_SCAN, COMANDO_UPDATE, COMANDO_ADD, COMANDO_BULK_ADD, COMANDO_DELETE,
+    COMANDO_BEGIN, COMANDO_COMMIT, COMANDO_STATS, COMANDO_OTRO,
+    CANTIDAD_COMANDOS
+};
+const char* NOMBRES_COMANDOS[CANTIDAD_COMANDOS] = {
+    "GET", "SCAN", "UPDATE", "ADD", "BULK_ADD", "DELETE", "BEGIN", "COMMIT", "STATS", "OTRO"
+};
+
+// Métricas agregadas de todos los procesos. Vive en memoria compartida creada antes de
+// los fork(), así que cada proceso hijo actualiza los mismos contadores con operaciones
+// atómicas y sin bloqueos.
+typedef struct {
+    uint64_t inicio_us;
+    Histograma comandos[CANTIDAD_COMANDOS];
+    uint64_t errores[CANTIDAD_COMANDOS];
+    Histograma transacciones;       // Duración BEGIN -> COMMIT (o desconexión).
+    uint64_t bloqueos_rechazados;   // flock con LOCK_NB que no se pudo obtener.
+    uint64_t bytes_leidos;          // Bytes leídos de los archivos de la base de datos.
+    uint64_t bytes_escritos;        // Bytes escritos en los archivos de la base de datos.
+    uint64_t conexiones_activas;    // Clientes admitidos directamente.
+    uint64_t conexiones_en_espera;  // Clientes que pasaron por la sala de espera.
+    uint64_t conexiones_rechazadas; // Clientes rechazados por servidor lleno.
+    // Solo las escribe el proceso padre, que es el que administra la admisión.
+    int64_t clientes_activos;
+    int64_t sala_espera_actual;
+    int64_t sala_espera_maxima;
+    uint64_t fsyncs;                // Sincronizaciones del CSV hechas en COMMIT.
+    uint64_t commits_durables;      // Commits con escrituras confirmados en disco.
+    int64_t ingesta_activa;         // 1 mientras corre una ingesta del generador (lo escribe el padre).
+    int64_t replicas_conectadas;    // Primario: réplicas recibiendo cambios (lo escribe el padre).
+    uint64_t registro_base;         // Primario: LSN del primer byte de output.log (cambia con LOCK_EX).
+    // Réplica: estado del proceso aplicador.
+    int64_t replica_conectada;
+    uint64_t replica_lsn_primario;  // Último LSN anunciado por el primario.
+    uint64_t replica_lsn_aplicado;  // LSN hasta el que la réplica aplicó los cambios.
+    uint64_t replica_marca_us;      // Hora del primario (tiempo real) hasta la que la réplica está al día.
+    uint64_t replica_transacciones; // Transacciones del primario aplicadas.
+} Metricas;
+
+Metricas* metricas = NULL;
+
+// Estado compartido del group commit (líder/seguidores). Cada commit con escrituras toma
+// un número de secuencia mientras aún tiene el bloqueo exclusivo; luego lo libera y espera
+// a que ultimo_durable lo alcance. El primero en llegar se vuelve líder, espera hasta
+// espera_grupo_us a que otros commits se sumen, hace un único fsync y despierta a todos.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t durable;
+    uint64_t ultimo_asignado;
+    uint64_t ultimo_durable; // Última secuencia cuyo fsync terminó, con éxito o no.
+    uint64_t ultimo_fallido; // Mayor secuencia de un grupo cuyo fsync falló (0 si ninguno).
+    pid_t lider; // 0 si no hay líder.
+} GrupoCommit;
+
+GrupoCommit* grupo_commit = NULL;
+
 // Prototipos de funciones.
 void manejar_cliente(int socket_cliente);
+void metricas_sumar(uint64_t* contador, uint64_t valor);
+void metricas_actualizar_admision();
+int clasificar_comando(const char* comando);
+void registrar_comando(int comando, uint64_t inicio_us, const char* respuesta);
+void escribir_metricas(FILE* salida);
+bool enviar_estadisticas(int socket_cliente);
+void servir_metricas(int socket_metricas);
+bool inicializar_grupo_commit();
+bool sincronizar_base_de_datos();
+bool reemplazar_base_de_datos();
+uint64_t registrar_commit_pendiente();
+bool esperar_commit_durable(uint64_t secuencia, int fd_bloqueo);
+void respuesta_agregar_fila(RespuestaEnBloques* respuesta, const char* fila);
+bool respuesta_finalizar(RespuestaEnBloques* respuesta);
+bool escanear_registros(int socket_cliente, long id_desde, long id_hasta);
 void buscar_registro_por_id(long id_buscado, char* resultado, size_t resultado_len);
 void actualizar_registro_por_id(long id_buscado, int indice_campo, const char* nuevo_valor, char* respuesta, size_t respuesta_len);
 void agregar_registro(const char* datos_registro, char* respuesta, size_t respuesta_len);
+int agregar_registros_en_lote(LectorSocket* lector, bool en_transaccion, char* respuesta, size_t respuesta_len);
+void indexar_filas(const char* filas, size_t largo, off_t base, long id_inicial);
 void eliminar_registro_por_id(long id_buscado, char* respuesta, size_t respuesta_len);
-long obtener_max_id();
+long obtener_proximo_id();
+bool crear_indice();
+bool cargar_snapshot_indice();
+void guardar_snapshot_indice();
+bool construir_indice();
+void vaciar_indice();
+bool indice_vigente();
+void indice_marcar_vigente();
+off_t indice_invalidar();
+void indice_registrar(long id, off_t desplazamiento);
+void indice_eliminar(long id);
+off_t indice_buscar(long id);
+bool fila_ingesta_valida(const char* linea);
+void manejar_ingesta(int socket_ingesta);
+void configurar_archivos(const char* ruta_bd);
+pid_t lanzar_proceso_auxiliar(void (*funcion)(int), int fd, volatile pid_t* destino);
+void agregar_a_cambios(const char* datos, size_t largo);
+void registrar_cambio(const char* formato, ...);
+void registrar_filas_cambiadas(const char* filas, size_t largo);
+void publicar_cambios();
+void manejar_replicacion(int socket_replica);
+void ejecutar_replica(int no_usado);
+uint64_t tiempo_real_us();
+bool aplicar_cambios_replicados(char* texto, size_t largo);
 
 // Manejador que se activa cuando un cliente activo se desconecta.
 void manejador_sigchld(int signum) {
     // Ignora el parámetro para evitar advertencias.
     (void)signum;
     // Recolecta todos los procesos hijos terminados.
-    while (waitpid(-1, NULL, WNOHANG) > 0) {
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        // El fin de una ingesta no libera un lugar de cliente.
+        if (pid == pid_ingesta) {
+            pid_ingesta = 0;
+            __atomic_store_n(&metricas->ingesta_activa, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+        // Tampoco el de los procesos de replicación.
+        if (pid == pid_aplicador) {
+            pid_aplicador = 0;
+            continue;
+        }
+        bool era_replica = false;
+        for (int i = 0; i < MAX_REPLICAS; i++) {
+            if (pids_replicacion[i] == pid) {
+                pids_replicacion[i] = 0;
+                era_replica = true;
+            }
+        }
+        if (era_replica) {
+            // Atómico: el manejador puede interrumpir al padre en medio del incremento.
+            int64_t replicas = __atomic_sub_fetch(&metricas->replicas_conectadas, 1, __ATOMIC_RELAXED);
+            printf("Una réplica se ha desconectado. Réplicas: %lld\n", (long long)replicas);
+            continue;
+        }
         clientes_activos--;
+        metricas_actualizar_admision();
         printf("Un cliente activo se ha desconectado. Clientes activos: %d\n", clientes_activos);
         
         // Si hay clientes en la sala de espera, damos paso al primero.
@@ -51,25 +280,145 @@ void manejador_sigchld(int signum) {
             clientes_en_espera_app--;
 
             // Creamos el proceso hijo para el cliente que estaba esperando.
+            fflush(stdout);
             if (fork() == 0) {
                 manejar_cliente(socket_a_promover);
                 exit(0);
             }
             clientes_activos++;
+            metricas_actualizar_admision();
             printf("Cliente en espera promovido a activo. Clientes activos: %d, en espera: %d\n", clientes_activos, clientes_en_espera_app);
         }
     }
 }
 
+// Muestra cómo usar el programa.
+void mostrar_ayuda(const char* nombre_programa) {
+    fprintf(stderr, "Uso: %s <puerto> <clientes_concurrentes> <clientes_en_espera> [opciones]\n", nombre_programa);
+    fprintf(stderr, "Opciones:\n");
+    fprintf(stderr, "  --puerto-metricas <puerto>  Publica las métricas en texto plano en 127.0.0.1:<puerto>\n");
+    fprintf(stderr, "  --durabilidad <modo>        ninguna (por defecto), fsync (en cada commit) o grupo (group commit)\n");
+    fprintf(stderr, "  --espera-grupo-us <us>      Espera máxima del líder en modo grupo (por defecto 1000)\n");
+    fprintf(stderr, "  --ingesta <ruta_socket>     Recibe registros del generador por un socket local (ver generador --servidor)\n");
+    fprintf(stderr, "  --bd <archivo_csv>          Base de datos a servir (por defecto output.csv); los archivos auxiliares\n");
+    fprintf(stderr, "                              (.tmp, .lock, .idx, .log) toman el mismo nombre\n");
+    fprintf(stderr, "  --replicacion <puerto>      Publica los cambios confirmados para réplicas en <puerto>\n");
+    fprintf(stderr, "  --replica-of <host:puerto>  Réplica de solo lectura del primario indicado (requiere --bd)\n");
+    fprintf(stderr, "Ejemplo: %s 8080 5 10 --puerto-metricas 9100 --durabilidad grupo\n", nombre_programa);
+    fprintf(stderr, "Réplica: %s 8081 5 10 --bd replica.csv --replica-of 127.0.0.1:9200\n", nombre_programa);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Uso: %s <puerto> <clientes_concurrentes> <clientes_en_espera>\n", argv[0]);
+    if (argc < 4) {
+        mostrar_ayuda(argv[0]);
         return 1;
     }
     // Convierte los argumentos a enteros.
     int puerto = atoi(argv[1]);
     int max_clientes_concurrentes = atoi(argv[2]);
     int max_clientes_espera = atoi(argv[3]);
+    int puerto_metricas = 0;
+    const char* ruta_ingesta = NULL;
+    bool bd_configurada = false;
+    int puerto_replicacion = 0;
+
+    // Opciones adicionales.
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--puerto-metricas") == 0 && i + 1 < argc) {
+            puerto_metricas = atoi(argv[++i]);
+            if (puerto_metricas <= 0 || puerto_metricas > 65535) {
+                fprintf(stderr, "Error: Puerto de métricas inválido.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--durabilidad") == 0 && i + 1 < argc) {
+            const char* modo = argv[++i];
+            if (strcmp(modo, "ninguna") == 0) modo_durabilidad = DURABILIDAD_NINGUNA;
+            else if (strcmp(modo, "fsync") == 0) modo_durabilidad = DURABILIDAD_FSYNC;
+            else if (strcmp(modo, "grupo") == 0) modo_durabilidad = DURABILIDAD_GRUPO;
+            else {
+                fprintf(stderr, "Error: Modo de durabilidad inválido: %s\n", modo);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ingesta") == 0 && i + 1 < argc) {
+            ruta_ingesta = argv[++i];
+            if (strlen(ruta_ingesta) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+                fprintf(stderr, "Error: Ruta del socket de ingesta demasiado larga.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bd") == 0 && i + 1 < argc) {
+            configurar_archivos(argv[++i]);
+            bd_configurada = true;
+        } else if (strcmp(argv[i], "--replicacion") == 0 && i + 1 < argc) {
+            puerto_replicacion = atoi(argv[++i]);
+            if (puerto_replicacion <= 0 || puerto_replicacion > 65535) {
+                fprintf(stderr, "Error: Puerto de replicación inválido.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replica-of") == 0 && i + 1 < argc) {
+            replica_de = argv[++i];
+            const char* separador = strrchr(replica_de, ':');
+            if (!separador || separador == replica_de || atoi(separador + 1) <= 0) {
+                fprintf(stderr, "Error: --replica-of espera <host:puerto>.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--espera-grupo-us") == 0 && i + 1 < argc) {
+            espera_grupo_us = atol(argv[++i]);
+            if (espera_grupo_us < 0) {
+                fprintf(stderr, "Error: La espera del grupo no puede ser negativa.\n");
+                return 1;
+            }
+        } else {
+            mostrar_ayuda(argv[0]);
+            return 1;
+        }
+    }
+    // Una réplica solo recibe datos del primario.
+    if (replica_de && (ruta_ingesta || puerto_replicacion > 0)) {
+        fprintf(stderr, "Error: Una réplica no admite --ingesta ni --replicacion.\n");
+        return 1;
+    }
+    // La réplica reescribe su CSV con lo que recibe: con los archivos por defecto, iniciada
+    // en el directorio del primario, pisaría su output.csv.
+    if (replica_de && !bd_configurada) {
+        fprintf(stderr, "Error: --replica-of requiere --bd con un archivo propio de la réplica.\n");
+        return 1;
+    }
+    struct stat estado_bd, estado_por_defecto;
+    if (replica_de && stat(NOMBRE_ARCHIVO_BD, &estado_bd) == 0 && stat(NOMBRE_ARCHIVO_BD_POR_DEFECTO, &estado_por_defecto) == 0
+        && estado_bd.st_dev == estado_por_defecto.st_dev && estado_bd.st_ino == estado_por_defecto.st_ino) {
+        fprintf(stderr, "Error: %s es %s; la réplica necesita un archivo distinto del primario.\n", NOMBRE_ARCHIVO_BD, NOMBRE_ARCHIVO_BD_POR_DEFECTO);
+        return 1;
+    }
+
+    // Crea las métricas compartidas antes de cualquier fork().
+    metricas = mmap(NULL, sizeof(Metricas), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (metricas == MAP_FAILED) {
+        perror("mmap de métricas");
+        return 1;
+    }
+    metricas->inicio_us = tiempo_actual_us();
+    if (modo_durabilidad == DURABILIDAD_GRUPO && !inicializar_grupo_commit()) {
+        fprintf(stderr, "Error: No se pudo crear el estado del group commit.\n");
+        return 1;
+    }
+
+    // Índice primario: se carga del snapshot o se construye una vez aquí, y los procesos
+    // hijos lo mantienen.
+    if (!crear_indice()) {
+        perror("mmap del índice");
+        return 1;
+    }
+    uint64_t inicio_indice = tiempo_actual_us();
+    if (cargar_snapshot_indice()) {
+        printf("Índice cargado de %s en %.1f ms: %ld registros, próximo ID %ld.\n", NOMBRE_ARCHIVO_INDICE,
+               (tiempo_actual_us() - inicio_indice) / 1000.0, indice->registros, indice->proximo_id);
+    } else if (construir_indice()) {
+        printf("Índice construido en %.1f ms: %ld registros, próximo ID %ld.\n",
+               (tiempo_actual_us() - inicio_indice) / 1000.0, indice->registros, indice->proximo_id);
+    } else if (!(replica_de && errno == ENOENT)) { // Una réplica nueva recibe el CSV del primario.
+        // Sin índice vigente, GET recorre el CSV y el primer BEGIN vuelve a intentarlo.
+        fprintf(stderr, "Aviso: No se pudo construir el índice de %s (%s).\n", NOMBRE_ARCHIVO_BD, strerror(errno));
+    }
 
     // Crea el socket del servidor.
     int socket_servidor = socket(AF_INET, SOCK_STREAM, 0);
@@ -98,20 +447,89 @@ int main(int argc, char *argv[]) {
     }
     printf("Servidor listo. Límite: %d activos, %d en espera. CLOSE para cerrar el servidor.\n", max_clientes_concurrentes, max_clientes_espera);
 
+    // Socket opcional de métricas, solo accesible desde la máquina local.
+    int socket_metricas = -1;
+    if (puerto_metricas > 0) {
+        socket_metricas = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in direccion_metricas;
+        memset(&direccion_metricas, 0, sizeof(direccion_metricas));
+        direccion_metricas.sin_family = AF_INET;
+        direccion_metricas.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        direccion_metricas.sin_port = htons(puerto_metricas);
+        setsockopt(socket_metricas, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        // accept() recién despierta al padre cuando llegó el pedido (o tras 1 s si el
+        // recolector no envía nada), así servir_metricas no tiene que esperarlo.
+        int espera_pedido_s = 1;
+        setsockopt(socket_metricas, IPPROTO_TCP, TCP_DEFER_ACCEPT, &espera_pedido_s, sizeof(espera_pedido_s));
+        if (socket_metricas < 0 || bind(socket_metricas, (struct sockaddr *)&direccion_metricas, sizeof(direccion_metricas)) < 0 || listen(socket_metricas, 8) < 0) {
+            perror("Socket de métricas"); return 1;
+        }
+        printf("Métricas disponibles en 127.0.0.1:%d\n", puerto_metricas);
+    }
+
+    // Replicación: el registro de cambios empieza vacío en cada arranque, porque toda
+    // réplica que se conecta recibe primero una copia base del CSV. Por lo mismo,
+    // publicar_cambios lo vacía mientras no haya réplicas conectadas.
+    int socket_replicacion = -1;
+    if (puerto_replicacion > 0) {
+        fd_registro_cambios = open(NOMBRE_ARCHIVO_CAMBIOS, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+        if (fd_registro_cambios < 0) {
+            perror(NOMBRE_ARCHIVO_CAMBIOS); return 1;
+        }
+        socket_replicacion = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in direccion_replicacion;
+        memset(&direccion_replicacion, 0, sizeof(direccion_replicacion));
+        direccion_replicacion.sin_family = AF_INET;
+        direccion_replicacion.sin_addr.s_addr = INADDR_ANY;
+        direccion_replicacion.sin_port = htons(puerto_replicacion);
+        setsockopt(socket_replicacion, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (socket_replicacion < 0 || bind(socket_replicacion, (struct sockaddr *)&direccion_replicacion, sizeof(direccion_replicacion)) < 0 || listen(socket_replicacion, MAX_REPLICAS) < 0) {
+            perror("Socket de replicación"); return 1;
+        }
+        printf("Replicación disponible en el puerto %d\n", puerto_replicacion);
+    }
+
+    // Socket local opcional para la ingesta directa desde el generador.
+    int socket_ingesta = -1;
+    if (ruta_ingesta) {
+        struct sockaddr_un direccion_ingesta;
+        memset(&direccion_ingesta, 0, sizeof(direccion_ingesta));
+        direccion_ingesta.sun_family = AF_UNIX;
+        snprintf(direccion_ingesta.sun_path, sizeof(direccion_ingesta.sun_path), "%s", ruta_ingesta);
+        unlink(ruta_ingesta); // Socket que pudo quedar de una ejecución anterior.
+        socket_ingesta = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_ingesta < 0 || bind(socket_ingesta, (struct sockaddr *)&direccion_ingesta, sizeof(direccion_ingesta)) < 0 || listen(socket_ingesta, 1) < 0) {
+            perror("Socket de ingesta"); return 1;
+        }
+        printf("Ingesta disponible en %s\n", ruta_ingesta);
+    }
+
     // Configura el manejador de señales para SIGCHLD
     signal(SIGCHLD, manejador_sigchld);
     // Convierte a este proceso en el líder de un nuevo grupo de procesos.
     setpgid(0, 0);
 
+    // En una réplica, un proceso hijo mantiene la base al día con el primario.
+    if (replica_de) {
+        lanzar_proceso_auxiliar(ejecutar_replica, -1, &pid_aplicador);
+        printf("Réplica de solo lectura de %s\n", replica_de);
+    }
+
     // Bucle principal para aceptar conexiones y comandos.
     while (true) {
         fd_set read_fds;
         FD_ZERO(&read_fds);
         FD_SET(socket_servidor, &read_fds);
         FD_SET(STDIN_FILENO, &read_fds); // STDIN_FILENO es 0 (entrada estándar)
+        if (socket_metricas >= 0) FD_SET(socket_metricas, &read_fds);
+        if (socket_ingesta >= 0) FD_SET(socket_ingesta, &read_fds);
+        int fd_maximo = socket_servidor > socket_metricas ? socket_servidor : socket_metricas;
+        if (socket_ingesta > fd_maximo) fd_maximo = socket_ingesta;
+        if (socket_replicacion >= 0) FD_SET(socket_replicacion, &read_fds);
+        if (socket_replicacion > fd_maximo) fd_maximo = socket_replicacion;
 
         // select() se bloquea hasta que haya actividad en el socket o en la terminal.
-        if (select(socket_servidor + 1, &read_fds, NULL, NULL, NULL) < 0) {
+        if (select(fd_maximo + 1, &read_fds, NULL, NULL, NULL) < 0) {
             if (errno == EINTR) continue; // Si es interrumpido por una señal, reintenta.
             perror("select");
             break;
@@ -123,13 +541,61 @@ int main(int argc, char *argv[]) {
                 command_buffer[strcspn(command_buffer, "\r\n")] = 0;
                 if (strcmp(command_buffer, "CLOSE") == 0) {
                     printf("Comando CLOSE recibido. Cerrando el servidor y todos los clientes...\n");
-                    // Envía la señal de terminación a todo el grupo de procesos (padre y todos los hijos).
+                    // Envía la señal de terminación a todo el grupo de procesos. El padre la ignora
+                    // para poder liberar sus recursos antes de salir.
+                    signal(SIGTERM, SIG_IGN);
                     kill(0, SIGTERM);
                     break; // Sale del bucle para apagar.
                 }
             }
         }
 
+        // Pedido de métricas: se responde desde el proceso padre, sin fork().
+        if (socket_metricas >= 0 && FD_ISSET(socket_metricas, &read_fds)) {
+            servir_metricas(socket_metricas);
+        }
+
+        // Nueva ingesta desde el generador: se atiende en un proceso hijo, de a una por vez.
+        if (socket_ingesta >= 0 && FD_ISSET(socket_ingesta, &read_fds)) {
+            int socket_generador = accept(socket_ingesta, NULL, NULL);
+            if (socket_generador >= 0 && pid_ingesta != 0) {
+                const char* msg = "ERROR|Ya hay una ingesta en curso.\n";
+                write(socket_generador, msg, strlen(msg));
+                close(socket_generador);
+            } else if (socket_generador >= 0) {
+                // Se marca antes del fork, así ya está visible cuando la ingesta reinicia la base.
+                __atomic_store_n(&metricas->ingesta_activa, 1, __ATOMIC_RELAXED);
+                if (lanzar_proceso_auxiliar(manejar_ingesta, socket_generador, &pid_ingesta) <= 0) {
+                    __atomic_store_n(&metricas->ingesta_activa, 0, __ATOMIC_RELAXED);
+                }
+                close(socket_generador);
+                printf("Ingesta iniciada desde el generador.\n");
+            }
+        }
+
+        // Nueva réplica: un proceso hijo le envía la copia base y luego los cambios.
+        if (socket_replicacion >= 0 && FD_ISSET(socket_replicacion, &read_fds)) {
+            int socket_replica = accept(socket_replicacion, NULL, NULL);
+            int lugar = -1;
+            for (int i = 0; i < MAX_REPLICAS && lugar < 0; i++) {
+                if (pids_replicacion[i] == 0) lugar = i;
+            }
+            if (socket_replica >= 0 && lugar < 0) {
+                const char* msg = "ERROR|Demasiadas réplicas conectadas.\n";
+                write(socket_replica, msg, strlen(msg));
+                close(socket_replica);
+            } else if (socket_replica >= 0) {
+                // Se cuenta antes del fork: desde que el hijo toma su copia base, ninguna
+                // transacción puede vaciar el registro que va a seguir.
+                __atomic_fetch_add(&metricas->replicas_conectadas, 1, __ATOMIC_RELAXED);
+                if (lanzar_proceso_auxiliar(manejar_replicacion, socket_replica, &pids_replicacion[lugar]) <= 0) {
+                    __atomic_sub_fetch(&metricas->replicas_conectadas, 1, __ATOMIC_RELAXED);
+                }
+                close(socket_replica);
+                printf("Réplica conectada. Réplicas: %lld\n", (long long)__atomic_load_n(&metricas->replicas_conectadas, __ATOMIC_RELAXED));
+            }
+        }
+
         // Verifica si hay una nueva conexión en el socket del servidor.
         if (FD_ISSET(socket_servidor, &read_fds)) {
             int socket_cliente = accept(socket_servidor, NULL, NULL);
@@ -141,6 +607,7 @@ int main(int argc, char *argv[]) {
                 const char* msg = "OK_CONNECT\n";
                 write(socket_cliente, msg, strlen(msg));
                 
+                fflush(stdout); // Evita que el hijo repita lo pendiente en el buffer.
                 if (fork() == 0) 
                 {
                     // Proceso hijo maneja al cliente.
@@ -149,24 +616,44 @@ int main(int argc, char *argv[]) {
                 }
                 // Proceso padre continúa aceptando conexiones.
                 clientes_activos++;
+                metricas_sumar(&metricas->conexiones_activas, 1);
+                metricas_actualizar_admision();
                 printf("Cliente aceptado como activo. Activos: %d, En espera: %d\n", clientes_activos, clientes_en_espera_app);
             } else if (clientes_en_espera_app < max_clientes_espera) {
                 // No hay espacio activo, pero sí en la sala de espera.
                 const char* msg = "WAIT\n";
                 write(socket_cliente, msg, strlen(msg));
                 sockets_en_espera[clientes_en_espera_app++] = socket_cliente;
+                metricas_sumar(&metricas->conexiones_en_espera, 1);
+                metricas_actualizar_admision();
                 printf("Cliente puesto en espera. Activos: %d, En espera: %d\n", clientes_activos, clientes_en_espera_app);
             } else {
                 // El servidor está completamente lleno.
                 const char* msg = "REJECT\n";
                 write(socket_cliente, msg, strlen(msg));
                 close(socket_cliente);
+                metricas_sumar(&metricas->conexiones_rechazadas, 1);
                 printf("Servidor lleno. Cliente rechazado.\n");
             }
         }
     }
     
     close(socket_servidor);
+    if (socket_metricas >= 0) close(socket_metricas);
+    if (socket_ingesta >= 0) {
+        close(socket_ingesta);
+        unlink(ruta_ingesta);
+    }
+    if (socket_replicacion >= 0) close(socket_replicacion);
+    // Con el bloqueo exclusivo (los hijos terminados ya lo soltaron) el índice describe
+    // exactamente el CSV y se puede guardar como snapshot.
+    int fd_bloqueo = open(NOMBRE_ARCHIVO_BLOQUEO, O_RDWR | O_CREAT, 0666);
+    if (fd_bloqueo >= 0) flock(fd_bloqueo, LOCK_EX);
+    guardar_snapshot_indice();
+    if (fd_bloqueo >= 0) close(fd_bloqueo);
+    munmap(metricas, sizeof(Metricas));
+    if (grupo_commit) munmap(grupo_commit, sizeof(GrupoCommit));
+    remove(NOMBRE_ARCHIVO_BLOQUEO);
     printf("Servidor cerrado.\n");
     return 0;
 }
@@ -179,36 +666,62 @@ void manejar_cliente(int socket_cliente) {
     char buffer[TAMANIO_BUFFER];
     char respuesta[TAMANIO_BUFFER];
     bool en_transaccion = false;
+    bool transaccion_con_escrituras = false;
+    uint64_t inicio_transaccion = 0;
+    LectorSocket lector;
+    lector_inicializar(&lector, socket_cliente);
 
-    // Abre el archivo de la base de datos.
-    int fd_bd = open(NOMBRE_ARCHIVO_BD, O_RDWR);
-    if (fd_bd < 0) {
+    // Verifica la base de datos y abre el archivo de bloqueo.
+    int fd_bloqueo = open(NOMBRE_ARCHIVO_BLOQUEO, O_RDWR | O_CREAT, 0666);
+    if (access(NOMBRE_ARCHIVO_BD, R_OK | W_OK) != 0 || fd_bloqueo < 0) {
         snprintf(respuesta, sizeof(respuesta), "ERROR|No se pudo abrir la base de datos\n");
         write(socket_cliente, respuesta, strlen(respuesta));
+        if (fd_bloqueo >= 0) close(fd_bloqueo);
         close(socket_cliente);
         return;
     }
     printf("[PID: %d] Cliente conectado.\n", getpid());
+
+    // Un cliente que deja de leer no debe retener el bloqueo compartido indefinidamente.
+    struct timeval timeout_envio = { .tv_sec = TIMEOUT_ENVIO_SEGUNDOS, .tv_usec = 0 };
+    setsockopt(socket_cliente, SOL_SOCKET, SO_SNDTIMEO, &timeout_envio, sizeof(timeout_envio));
     
     // Bucle principal para manejar comandos del cliente.
     while (true) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_leidos = read(socket_cliente, buffer, sizeof(buffer) - 1);
-        if (bytes_leidos <= 0) {
+        // Lee el próximo comando completo (sin saltos de línea).
+        if (leer_linea(&lector, buffer, sizeof(buffer)) <= 0) {
             printf("[PID: %d] Cliente desconectado.\n", getpid());
             break;
         }
-        // Elimina saltos de línea para facilitar el procesamiento.
-        buffer[strcspn(buffer, "\r\n")] = 0;
+        uint64_t inicio_comando = tiempo_actual_us();
+        int comando = clasificar_comando(buffer);
+        respuesta[0] = '\0';
 
         if (strcmp(buffer, "BEGIN TRANSACTION") == 0) 
         {
-            // Intenta obtener un bloqueo EXCLUSIVO sin esperar.
-            if (flock(fd_bd, LOCK_EX | LOCK_NB) == 0) {
+            if (replica_de) {
+                // Una réplica solo cambia con lo que aplica del primario.
+                snprintf(respuesta, sizeof(respuesta), "ERROR|Servidor de solo lectura (réplica de %s).", replica_de);
+            } else if (flock(fd_bloqueo, LOCK_EX | LOCK_NB) != 0) {
+                metricas_sumar(&metricas->bloqueos_rechazados, 1);
+                snprintf(respuesta, sizeof(respuesta), "ERROR|Base de datos bloqueada por otra transacción.");
+            } else if (__atomic_load_n(&metricas->ingesta_activa, __ATOMIC_RELAXED)) {
+                // Mientras el generador ingresa registros, los IDs nuevos son suyos: un ADD
+                // tomaría IDs que luego llegan por la ingesta. Se controla con el bloqueo ya
+                // tomado, porque la ingesta se marca antes de reiniciar la base.
+                flock(fd_bloqueo, LOCK_UN);
+                snprintf(respuesta, sizeof(respuesta), "ERROR|Ingesta del generador en curso; la base es de solo lectura hasta que termine.");
+            } else if (!indice_vigente() && !construir_indice()) {
+                // Si el CSV cambió por fuera del servidor, el índice se reconstruye. Sin él,
+                // el próximo ID de ADD sería 0 y repetiría IDs existentes.
+                flock(fd_bloqueo, LOCK_UN);
+                snprintf(respuesta, sizeof(respuesta), "ERROR|No se pudo construir el índice de la base de datos.");
+            } else {
+                // Obtuvo el bloqueo EXCLUSIVO sin esperar.
                 en_transaccion = true;
+                transaccion_con_escrituras = false;
+                inicio_transaccion = inicio_comando;
                 snprintf(respuesta, sizeof(respuesta), "Transacción iniciada.");
-            } else {
-                snprintf(respuesta, sizeof(respuesta), "ERROR|Base de datos bloqueada por otra transacción.");
             }
 
         } 
@@ -216,9 +729,30 @@ void manejar_cliente(int socket_cliente) {
         else if (strcmp(buffer, "COMMIT TRANSACTION") == 0) 
         {
             if (en_transaccion) {
-                flock(fd_bd, LOCK_UN); // Libera el bloqueo.
+                bool durable = true;
+                uint64_t secuencia = 0;
+                // Una transacción de solo lectura no necesita llegar a disco.
+                if (transaccion_con_escrituras && modo_durabilidad == DURABILIDAD_FSYNC) {
+                    durable = sincronizar_base_de_datos();
+                    if (durable) metricas_sumar(&metricas->commits_durables, 1);
+                } else if (transaccion_con_escrituras && modo_durabilidad == DURABILIDAD_GRUPO) {
+                    secuencia = registrar_commit_pendiente();
+                }
+                if (transaccion_con_escrituras) {
+                    indice_marcar_vigente();
+                    publicar_cambios(); // Las réplicas ven la transacción completa o nada.
+                }
+                flock(fd_bloqueo, LOCK_UN); // Libera el bloqueo.
+                // En modo grupo se espera el fsync sin el bloqueo, así la próxima transacción
+                // puede avanzar y sumarse al mismo grupo.
+                if (secuencia > 0) durable = esperar_commit_durable(secuencia, fd_bloqueo);
                 en_transaccion = false;
-                snprintf(respuesta, sizeof(respuesta), "Transacción confirmada.");
+                histograma_registrar(&metricas->transacciones, tiempo_actual_us() - inicio_transaccion);
+                if (durable) {
+                    snprintf(respuesta, sizeof(respuesta), "Transacción confirmada.");
+                } else {
+                    snprintf(respuesta, sizeof(respuesta), "ERROR|Transacción aplicada pero no se pudo sincronizar a disco.");
+                }
             } else {
                 snprintf(respuesta, sizeof(respuesta), "ERROR|No hay transacción activa.");
             }
@@ -235,12 +769,13 @@ void manejar_cliente(int socket_cliente) {
                     buscar_registro_por_id(id, respuesta, sizeof(respuesta));
                 } else {
                     // Intenta obtener un bloqueo de lectura sin esperar.
-                    if (flock(fd_bd, LOCK_SH | LOCK_NB) == 0) {
+                    if (flock(fd_bloqueo, LOCK_SH | LOCK_NB) == 0) {
                         // Bloqueo de lectura obtenido con éxito.
                         buscar_registro_por_id(id, respuesta, sizeof(respuesta));
-                        flock(fd_bd, LOCK_UN); // Liberar inmediatamente después de leer.
+                        flock(fd_bloqueo, LOCK_UN); // Liberar inmediatamente después de leer.
                     } else {
                         // No se pudo obtener el bloqueo de lectura, significa que hay una transacción activa.
+                        metricas_sumar(&metricas->bloqueos_rechazados, 1);
                         snprintf(respuesta, sizeof(respuesta), "ERROR|Base de datos bloqueada por una transacción.");
                     }
                 }
@@ -250,12 +785,40 @@ void manejar_cliente(int socket_cliente) {
 
         } 
         
+        else if (strcmp(buffer, "SCAN") == 0 || strncmp(buffer, "SCAN ", 5) == 0) 
+        {
+            long desde = 0, hasta = LONG_MAX;
+            if (strcmp(buffer, "SCAN") == 0 || sscanf(buffer, "SCAN %ld %ld", &desde, &hasta) == 2) {
+                bool enviado;
+                if (en_transaccion) {
+                    enviado = escanear_registros(socket_cliente, desde, hasta);
+                } else if (flock(fd_bloqueo, LOCK_SH | LOCK_NB) == 0) {
+                    enviado = escanear_registros(socket_cliente, desde, hasta);
+                    flock(fd_bloqueo, LOCK_UN);
+                } else {
+                    metricas_sumar(&metricas->bloqueos_rechazados, 1);
+                    snprintf(respuesta, sizeof(respuesta), "ERROR|Base de datos bloqueada por una transacción.\n");
+                    enviado = enviar_todo(socket_cliente, respuesta, strlen(respuesta));
+                }
+                if (!enviado) {
+                    printf("[PID: %d] Cliente dejó de recibir durante SCAN.\n", getpid());
+                    break;
+                }
+                registrar_comando(comando, inicio_comando, respuesta);
+                continue; // La respuesta ya fue enviada por bloques.
+            } else {
+                snprintf(respuesta, sizeof(respuesta), "ERROR|Uso: SCAN [<ID_desde> <ID_hasta>]");
+            }
+
+        } 
+        
         else if (strncmp(buffer, "UPDATE ", 7) == 0) 
         {
             long id; int campo; char valor[TAMANIO_BUFFER];
 
             if (sscanf(buffer, "UPDATE %ld %d %[^\n]", &id, &campo, valor) == 3) {
                 if (en_transaccion) {
+                    transaccion_con_escrituras = true;
                     actualizar_registro_por_id(id, campo, valor, respuesta, sizeof(respuesta));
                 } else {
                     snprintf(respuesta, sizeof(respuesta), "ERROR|Operación requiere una transacción.");
@@ -269,17 +832,28 @@ void manejar_cliente(int socket_cliente) {
         else if (strncmp(buffer, "ADD ", 4) == 0) 
         {
             if (en_transaccion) {
+                transaccion_con_escrituras = true;
                 agregar_registro(buffer + 4, respuesta, sizeof(respuesta));
             } else {
                 snprintf(respuesta, sizeof(respuesta), "ERROR|Operación requiere una transacción.");
             }
 
         } 
+        else if (strcmp(buffer, "BULK ADD") == 0) 
+        {
+            // Las filas se consumen siempre hasta END, aun sin transacción, para no tomarlas como comandos.
+            if (en_transaccion) transaccion_con_escrituras = true;
+            if (agregar_registros_en_lote(&lector, en_transaccion, respuesta, sizeof(respuesta)) <= 0) {
+                printf("[PID: %d] Cliente desconectado durante BULK ADD.\n", getpid());
+                break;
+            }
+        } 
         else if (strncmp(buffer, "DELETE ", 7) == 0) 
         {
             long id;
             if (sscanf(buffer, "DELETE %ld", &id) == 1) {
                 if (en_transaccion) {
+                    transaccion_con_escrituras = true;
                     eliminar_registro_por_id(id, respuesta, sizeof(respuesta));
                 } else {
                     snprintf(respuesta, sizeof(respuesta), "ERROR|Operación requiere una transacción.");
@@ -289,6 +863,13 @@ void manejar_cliente(int socket_cliente) {
             }
 
         } 
+        else if (strcmp(buffer, "STATS") == 0)
+        {
+            // No toma el bloqueo: las métricas no dependen del archivo.
+            if (!enviar_estadisticas(socket_cliente)) break;
+            registrar_comando(comando, inicio_comando, respuesta);
+            continue;
+        }
         else if (strcmp(buffer, "EXIT") == 0)
         {
             snprintf(respuesta, sizeof(respuesta), "Saliendo...\n");
@@ -298,7 +879,7 @@ void manejar_cliente(int socket_cliente) {
 
         else if (strcmp(buffer, "HELP") == 0) 
         {
-            snprintf(respuesta, sizeof(respuesta), "Comandos: GET, UPDATE, ADD, DELETE, BEGIN TRANSACTION, COMMIT TRANSACTION, EXIT");
+            snprintf(respuesta, sizeof(respuesta), "Comandos: GET, SCAN, UPDATE, ADD, BULK ADD (filas hasta END), DELETE, BEGIN TRANSACTION, COMMIT TRANSACTION, STATS, EXIT");
         }
 
         else 
@@ -308,18 +889,391 @@ void manejar_cliente(int socket_cliente) {
         // Envía la respuesta al cliente.
         strncat(respuesta, "\n", sizeof(respuesta) - strlen(respuesta) - 1);
         write(socket_cliente, respuesta, strlen(respuesta));
+        registrar_comando(comando, inicio_comando, respuesta);
     }
 
-    if (en_transaccion) flock(fd_bd, LOCK_UN);
-    close(fd_bd);
+    if (en_transaccion) {
+        // Las escrituras ya están en el CSV (no hay rollback): también se replican.
+        if (transaccion_con_escrituras) {
+            indice_marcar_vigente();
+            publicar_cambios();
+        }
+        flock(fd_bloqueo, LOCK_UN);
+        histograma_registrar(&metricas->transacciones, tiempo_actual_us() - inicio_transaccion);
+    }
+    close(fd_bloqueo);
     close(socket_cliente);
 }
 
+// Suma a un contador compartido.
+void metricas_sumar(uint64_t* contador, uint64_t valor) {
+    __atomic_fetch_add(contador, valor, __ATOMIC_RELAXED);
+}
+
+// Refleja en las métricas el estado de admisión que administra el proceso padre.
+void metricas_actualizar_admision() {
+    metricas->clientes_activos = clientes_activos;
+    metricas->sala_espera_actual = clientes_en_espera_app;
+    if (clientes_en_espera_app > metricas->sala_espera_maxima) {
+        metricas->sala_espera_maxima = clientes_en_espera_app;
+    }
+}
+
+// Determina a qué comando de las métricas corresponde una línea recibida.
+int clasificar_comando(const char* comando) {
+    if (strncmp(comando, "GET ", 4) == 0) return COMANDO_GET;
+    if (strncmp(comando, "SCAN", 4) == 0) return COMANDO_SCAN;
+    if (strncmp(comando, "UPDATE ", 7) == 0) return COMANDO_UPDATE;
+    if (strncmp(comando, "ADD ", 4) == 0) return COMANDO_ADD;
+    if (strcmp(comando, "BULK ADD") == 0) return COMANDO_BULK_ADD;
+    if (strncmp(comando, "DELETE ", 7) == 0) return COMANDO_DELETE;
+    if (strcmp(comando, "BEGIN TRANSACTION") == 0) return COMANDO_BEGIN;
+    if (strcmp(comando, "COMMIT TRANSACTION") == 0) return COMANDO_COMMIT;
+    if (strcmp(comando, "STATS") == 0) return COMANDO_STATS;
+    return COMANDO_OTRO;
+}
+
+// Registra la latencia de un comando ya respondido y si terminó en error.
+void registrar_comando(int comando, uint64_t inicio_us, const char* respuesta) {
+    histograma_registrar(&metricas->comandos[comando], tiempo_actual_us() - inicio_us);
+    if (strncmp(respuesta, "ERROR|", 6) == 0) {
+        metricas_sumar(&metricas->errores[comando], 1);
+    }
+}
+
+// Escribe un percentil de un histograma con el formato de las métricas.
+void escribir_percentiles(FILE* salida, const char* nombre, const char* etiquetas, const Histograma* h) {
+    const char* separador = etiquetas[0] ? "," : "";
+    fprintf(salida, "%s{%s%scuantil=\"0.5\"} %llu\n", nombre, etiquetas, separador, (unsigned long long)histograma_percentil(h, 0.5));
+    fprintf(salida, "%s{%s%scuantil=\"0.99\"} %llu\n", nombre, etiquetas, separador, (unsigned long long)histograma_percentil(h, 0.99));
+    fprintf(salida, "%s{%s%scuantil=\"0.999\"} %llu\n", nombre, etiquetas, separador, (unsigned long long)histograma_percentil(h, 0.999));
+    fprintf(salida, etiquetas[0] ? "%s_max{%s} %llu\n" : "%s_max%s %llu\n", nombre, etiquetas, (unsigned long long)__atomic_load_n(&h->max_us, __ATOMIC_RELAXED));
+}
+
+// Vuelca todas las métricas en formato de texto "nombre{etiquetas} valor", una por línea.
+// Es el mismo texto que devuelve STATS y el socket de métricas.
+void escribir_metricas(FILE* salida) {
+    char etiquetas[64];
+    fprintf(salida, "servidor_uptime_us %llu\n", (unsigned long long)(tiempo_actual_us() - metricas->inicio_us));
+    for (int i = 0; i < CANTIDAD_COMANDOS; i++) {
+        const Histograma* h = &metricas->comandos[i];
+        uint64_t cantidad = __atomic_load_n(&h->cantidad, __ATOMIC_RELAXED);
+        snprintf(etiquetas, sizeof(etiquetas), "comando=\"%s\"", NOMBRES_COMANDOS[i]);
+        fprintf(salida, "servidor_comandos_total{%s} %llu\n", etiquetas, (unsigned long long)cantidad);
+        fprintf(salida, "servidor_comandos_errores_total{%s} %llu\n", etiquetas, (unsigned long long)__atomic_load_n(&metricas->errores[i], __ATOMIC_RELAXED));
+        if (cantidad > 0) {
+            escribir_percentiles(salida, "servidor_comando_latencia_us", etiquetas, h);
+        }
+    }
+    fprintf(salida, "servidor_transacciones_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->transacciones.cantidad, __ATOMIC_RELAXED));
+    escribir_percentiles(salida, "servidor_transaccion_duracion_us", "", &metricas->transacciones);
+    fprintf(salida, "servidor_bloqueos_rechazados_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->bloqueos_rechazados, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_archivo_bytes_leidos_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->bytes_leidos, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_archivo_bytes_escritos_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->bytes_escritos, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_conexiones_total{admision=\"activo\"} %llu\n", (unsigned long long)__atomic_load_n(&metricas->conexiones_activas, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_conexiones_total{admision=\"espera\"} %llu\n", (unsigned long long)__atomic_load_n(&metricas->conexiones_en_espera, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_conexiones_total{admision=\"rechazado\"} %llu\n", (unsigned long long)__atomic_load_n(&metricas->conexiones_rechazadas, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_clientes_activos %lld\n", (long long)metricas->clientes_activos);
+    fprintf(salida, "servidor_sala_espera_actual %lld\n", (long long)metricas->sala_espera_actual);
+    fprintf(salida, "servidor_sala_espera_maxima %lld\n", (long long)metricas->sala_espera_maxima);
+    fprintf(salida, "servidor_commits_durables_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->commits_durables, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_fsyncs_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->fsyncs, __ATOMIC_RELAXED));
+    fprintf(salida, "servidor_ingesta_activa %lld\n", (long long)__atomic_load_n(&metricas->ingesta_activa, __ATOMIC_RELAXED));
+    if (fd_registro_cambios >= 0) {
+        struct stat estado;
+        long long lsn = fstat(fd_registro_cambios, &estado) == 0 ? (long long)(__atomic_load_n(&metricas->registro_base, __ATOMIC_RELAXED) + estado.st_size) : -1;
+        fprintf(salida, "servidor_replicas_conectadas %lld\n", (long long)__atomic_load_n(&metricas->replicas_conectadas, __ATOMIC_RELAXED));
+        fprintf(salida, "servidor_replicacion_lsn %lld\n", lsn);
+    }
+    if (replica_de) {
+        uint64_t lsn_primario = __atomic_load_n(&metricas->replica_lsn_primario, __ATOMIC_RELAXED);
+        uint64_t lsn_aplicado = __atomic_load_n(&metricas->replica_lsn_aplicado, __ATOMIC_RELAXED);
+        uint64_t marca = __atomic_load_n(&metricas->replica_marca_us, __ATOMIC_RELAXED);
+        int64_t conectada = __atomic_load_n(&metricas->replica_conectada, __ATOMIC_RELAXED);
+        // Al día con el último latido: sin retraso. Si no, los datos son los que tenía el
+        // primario en la hora "marca" (o no hay datos todavía).
+        uint64_t ahora = tiempo_real_us();
+        long long retraso_ms = conectada && lsn_aplicado >= lsn_primario ? 0
+                             : marca > 0 && ahora > marca ? (long long)((ahora - marca) / 1000) : -1;
+        fprintf(salida, "servidor_replica_conectada %lld\n", (long long)conectada);
+        fprintf(salida, "servidor_replica_lsn_primario %llu\n", (unsigned long long)lsn_primario);
+        fprintf(salida, "servidor_replica_lsn_aplicado %llu\n", (unsigned long long)lsn_aplicado);
+        fprintf(salida, "servidor_replica_retraso_bytes %llu\n", (unsigned long long)(lsn_primario > lsn_aplicado ? lsn_primario - lsn_aplicado : 0));
+        fprintf(salida, "servidor_replica_retraso_ms %lld\n", retraso_ms);
+        fprintf(salida, "servidor_replica_transacciones_total %llu\n", (unsigned long long)__atomic_load_n(&metricas->replica_transacciones, __ATOMIC_RELAXED));
+    }
+}
+
+// Responde al comando STATS con una fila por métrica.
+bool enviar_estadisticas(int socket_cliente) {
+    char* texto = NULL;
+    size_t largo = 0;
+    FILE* salida = open_memstream(&texto, &largo);
+    if (!salida) {
+        const char* msg = "ERROR|No se pudieron generar las métricas.\n";
+        return enviar_todo(socket_cliente, msg, strlen(msg));
+    }
+    escribir_metricas(salida);
+    fclose(salida);
+
+    RespuestaEnBloques respuesta = { .fd = socket_cliente, .largo = 0, .filas = 0, .error = false };
+    for (char* linea = strtok(texto, "\n"); linea != NULL; linea = strtok(NULL, "\n")) {
+        respuesta_agregar_fila(&respuesta, linea);
+    }
+    free(texto);
+    return respuesta_finalizar(&respuesta);
+}
+
+// Atiende una conexión al socket de métricas: responde con el texto plano de las
+// métricas (con cabecera HTTP para que también sirva a curl o a un recolector) y cierra.
+// Se ejecuta en el proceso padre, así que nunca se bloquea: un recolector lento o que
+// no lee la respuesta se descarta en lugar de demorar el accept de los clientes.
+void servir_metricas(int socket_metricas) {
+    int socket_cliente = accept(socket_metricas, NULL, NULL);
+    if (socket_cliente < 0) return;
+    fcntl(socket_cliente, F_SETFL, fcntl(socket_cliente, F_GETFL) | O_NONBLOCK);
+
+    // Descarta el pedido que ya haya llegado; cerrar con datos sin leer enviaría un RST
+    // que puede hacerle perder la respuesta al recolector.
+    char pedido[TAMANIO_BUFFER];
+    while (recv(socket_cliente, pedido, sizeof(pedido), 0) > 0) { }
+
+    char* texto = NULL;
+    size_t largo = 0;
+    FILE* salida = open_memstream(&texto, &largo);
+    if (salida) {
+        fprintf(salida, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; charset=utf-8\r\n\r\n");
+        escribir_metricas(salida);
+        fclose(salida);
+        // Un solo envío sin bloqueo: la respuesta entra en el buffer del socket; si no
+        // entra, el recolector recibe una respuesta cortada y vuelve a intentar.
+        send(socket_cliente, texto, largo, MSG_DONTWAIT | MSG_NOSIGNAL);
+        free(texto);
+    }
+    shutdown(socket_cliente, SHUT_WR);
+    close(socket_cliente);
+}
+
+// Crea el estado del group commit en memoria compartida, con mutex y variable de
+// condición utilizables entre procesos.
+bool inicializar_grupo_commit() {
+    grupo_commit = mmap(NULL, sizeof(GrupoCommit), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (grupo_commit == MAP_FAILED) {
+        grupo_commit = NULL;
+        return false;
+    }
+    pthread_mutexattr_t atributos_mutex;
+    pthread_mutexattr_init(&atributos_mutex);
+    pthread_mutexattr_setpshared(&atributos_mutex, PTHREAD_PROCESS_SHARED);
+    // Si un proceso muere con el mutex tomado, el siguiente lo recupera en lugar de colgarse.
+    pthread_mutexattr_setrobust(&atributos_mutex, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&grupo_commit->mutex, &atributos_mutex);
+    pthread_mutexattr_destroy(&atributos_mutex);
+
+    pthread_condattr_t atributos_cond;
+    pthread_condattr_init(&atributos_cond);
+    pthread_condattr_setpshared(&atributos_cond, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&atributos_cond, CLOCK_MONOTONIC);
+    pthread_cond_init(&grupo_commit->durable, &atributos_cond);
+    pthread_condattr_destroy(&atributos_cond);
+    return true;
+}
+
+void grupo_commit_bloquear() {
+    if (pthread_mutex_lock(&grupo_commit->mutex) == EOWNERDEAD) {
+        pthread_mutex_consistent(&grupo_commit->mutex);
+    }
+}
+
+// Sincroniza un archivo o directorio a disco a partir de su ruta.
+bool sincronizar_ruta(const char* ruta, int flags) {
+    int fd = open(ruta, flags);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Lleva a disco el CSV y el directorio que lo contiene (este último hace durables
+// los rename de UPDATE/DELETE).
+bool sincronizar_base_de_datos() {
+    char directorio[TAMANIO_BUFFER];
+    const char* barra = strrchr(NOMBRE_ARCHIVO_BD, '/');
+    if (barra) snprintf(directorio, sizeof(directorio), "%.*s", (int)(barra - NOMBRE_ARCHIVO_BD + 1), NOMBRE_ARCHIVO_BD);
+    else snprintf(directorio, sizeof(directorio), ".");
+
+    bool ok = sincronizar_ruta(NOMBRE_ARCHIVO_BD, O_RDONLY) && sincronizar_ruta(directorio, O_RDONLY | O_DIRECTORY);
+    metricas_sumar(&metricas->fsyncs, 1);
+    return ok;
+}
+
+// Reemplaza el CSV por el archivo temporal. rename() sustituye el destino de forma
+// atómica; con durabilidad activa, antes se lleva el temporal a disco para que una caída
+// nunca deje un CSV renombrado pero vacío.
+bool reemplazar_base_de_datos() {
+    if (modo_durabilidad != DURABILIDAD_NINGUNA && !sincronizar_ruta(NOMBRE_ARCHIVO_TEMP, O_RDONLY)) {
+        return false;
+    }
+    return rename(NOMBRE_ARCHIVO_TEMP, NOMBRE_ARCHIVO_BD) == 0;
+}
+
+// Asigna el número de secuencia del commit. Se llama con el bloqueo exclusivo tomado,
+// por lo que el orden de las secuencias coincide con el de las transacciones.
+uint64_t registrar_commit_pendiente() {
+    grupo_commit_bloquear();
+    uint64_t secuencia = ++grupo_commit->ultimo_asignado;
+    pthread_mutex_unlock(&grupo_commit->mutex);
+    return secuencia;
+}
+
+// Espera a que el commit con la secuencia dada esté en disco, liderando un fsync si no
+// hay otro en curso. Devuelve false si el fsync de su grupo falló. Solo se recuerda el
+// último grupo fallido, así que un commit anterior que aún no despertó también informa
+// el error: ante la duda se responde como no durable, nunca al revés.
+bool esperar_commit_durable(uint64_t secuencia, int fd_bloqueo) {
+    grupo_commit_bloquear();
+    while (grupo_commit->ultimo_durable < secuencia) {
+        if (grupo_commit->lider == 0) {
+            // Este proceso es el líder del próximo grupo.
+            grupo_commit->lider = getpid();
+            pthread_mutex_unlock(&grupo_commit->mutex);
+
+            // Espera a que se sumen más commits mientras otra transacción siga en curso,
+            // hasta el máximo configurado. Si nadie tiene el bloqueo, no tiene sentido esperar.
+            uint64_t limite = tiempo_actual_us() + (uint64_t)espera_grupo_us;
+            while (tiempo_actual_us() < limite) {
+                if (flock(fd_bloqueo, LOCK_SH | LOCK_NB) == 0) {
+                    flock(fd_bloqueo, LOCK_UN);
+                    break;
+                }
+                usleep(50);
+            }
+
+            grupo_commit_bloquear();
+            uint64_t objetivo = grupo_commit->ultimo_asignado;
+            pthread_mutex_unlock(&grupo_commit->mutex);
+
+            bool sincronizado = sincronizar_base_de_datos();
+
+            grupo_commit_bloquear();
+            if (sincronizado) {
+                metricas_sumar(&metricas->commits_durables, objetivo - grupo_commit->ultimo_durable);
+            } else {
+                grupo_commit->ultimo_fallido = objetivo;
+            }
+            grupo_commit->ultimo_durable = objetivo;
+            grupo_commit->lider = 0;
+            pthread_cond_broadcast(&grupo_commit->durable);
+        } else {
+            // Seguidor: espera al líder. El timeout permite detectar un líder que murió.
+            struct timespec limite;
+            clock_gettime(CLOCK_MONOTONIC, &limite);
+            limite.tv_nsec += 100 * 1000000L;
+            if (limite.tv_nsec >= 1000000000L) {
+                limite.tv_sec++;
+                limite.tv_nsec -= 1000000000L;
+            }
+            int estado = pthread_cond_timedwait(&grupo_commit->durable, &grupo_commit->mutex, &limite);
+            if (estado == EOWNERDEAD) {
+                pthread_mutex_consistent(&grupo_commit->mutex);
+            }
+            if (estado != 0 && grupo_commit->lider != 0 && kill(grupo_commit->lider, 0) != 0 && errno == ESRCH) {
+                grupo_commit->lider = 0;
+            }
+        }
+    }
+    bool durable = secuencia > grupo_commit->ultimo_fallido;
+    pthread_mutex_unlock(&grupo_commit->mutex);
+    return durable;
+}
+
+// Agrega una fila a la respuesta; si el bloque se llena, lo envía antes de continuar.
+void respuesta_agregar_fila(RespuestaEnBloques* respuesta, const char* fila) {
+    if (respuesta->error) return;
+    size_t largo_contenido = strlen(fila);
+    size_t largo_fila = strlen("ROW|") + largo_contenido + 1;
+    if (respuesta->largo + largo_fila > sizeof(respuesta->datos)) {
+        if (!enviar_todo(respuesta->fd, respuesta->datos, respuesta->largo)) {
+            respuesta->error = true;
+            return;
+        }
+        respuesta->largo = 0;
+    }
+    // Se copia con largos explícitos: la fila puede ocupar el bloque hasta el último byte
+    // (snprintf reservaría uno para el '\0' y perdería el '\n').
+    char* destino = respuesta->datos + respuesta->largo;
+    memcpy(destino, "ROW|", strlen("ROW|"));
+    memcpy(destino + strlen("ROW|"), fila, largo_contenido);
+    destino[largo_fila - 1] = '\n';
+    respuesta->largo += largo_fila;
+    respuesta->filas++;
+}
+
+// Envía lo pendiente junto con la marca de fin de resultado.
+bool respuesta_finalizar(RespuestaEnBloques* respuesta) {
+    if (respuesta->error) return false;
+    if (sizeof(respuesta->datos) - respuesta->largo < 32) {
+        if (!enviar_todo(respuesta->fd, respuesta->datos, respuesta->largo)) return false;
+        respuesta->largo = 0;
+    }
+    respuesta->largo += snprintf(respuesta->datos + respuesta->largo, sizeof(respuesta->datos) - respuesta->largo, "END|%ld\n", respuesta->filas);
+    return enviar_todo(respuesta->fd, respuesta->datos, respuesta->largo);
+}
+
+// Envía en bloques todos los registros cuyo ID está en [id_desde, id_hasta].
+// Devuelve false si no se pudo completar el envío al cliente.
+bool escanear_registros(int socket_cliente, long id_desde, long id_hasta) {
+    FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "r");
+    if (!archivo) {
+        const char* msg = "ERROR|No se pudo abrir la BD\n";
+        return enviar_todo(socket_cliente, msg, strlen(msg));
+    }
+    RespuestaEnBloques respuesta = { .fd = socket_cliente, .largo = 0, .filas = 0, .error = false };
+
+    char linea[TAMANIO_BUFFER];
+    fgets(linea, sizeof(linea), archivo); // Salta la cabecera.
+    while (!respuesta.error && fgets(linea, sizeof(linea), archivo)) {
+        long id_actual;
+        if (sscanf(linea, "%ld,", &id_actual) == 1 && id_actual >= id_desde && id_actual <= id_hasta) {
+            linea[strcspn(linea, "\r\n")] = 0;
+            respuesta_agregar_fila(&respuesta, linea);
+        }
+    }
+    metricas_sumar(&metricas->bytes_leidos, ftell(archivo));
+    fclose(archivo);
+    return respuesta_finalizar(&respuesta);
+}
+
 // Funciones de búsqueda y actualización.
 void buscar_registro_por_id(long id_buscado, char* resultado, size_t resultado_len) {
     FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "r");
     if (!archivo) {snprintf(resultado, resultado_len, "ERROR|No se pudo abrir la BD"); return;}
     char linea[TAMANIO_BUFFER]; bool encontrado = false;
+
+    // Con el índice se lee directamente la línea del registro.
+    if (id_buscado >= 0 && id_buscado < CAPACIDAD_INDICE && indice_vigente()) {
+        off_t desplazamiento = indice_buscar(id_buscado);
+        long id_actual;
+        if (desplazamiento == 0) {
+            // Se confía en el índice sin recorrer el archivo: un ID ausente no cuesta un
+            // recorrido completo. Solo un snapshot cuya etiqueta heurística no detectó una
+            // edición externa (ver suma_control_csv) podría dar aquí un falso "no encontrado".
+            snprintf(resultado, resultado_len, "ERROR|ID %ld no encontrado.", id_buscado);
+            fclose(archivo);
+            return;
+        }
+        if (fseeko(archivo, desplazamiento, SEEK_SET) == 0 && fgets(linea, sizeof(linea), archivo)
+            && sscanf(linea, "%ld,", &id_actual) == 1 && id_actual == id_buscado) {
+            metricas_sumar(&metricas->bytes_leidos, strlen(linea));
+            linea[strcspn(linea, "\r\n")] = 0;
+            snprintf(resultado, resultado_len, "%s", linea);
+            fclose(archivo);
+            return;
+        }
+        // El índice no coincide con el archivo: se recurre a la búsqueda secuencial.
+        rewind(archivo);
+    }
+
     fgets(linea, sizeof(linea), archivo);
     while (fgets(linea, sizeof(linea), archivo)) {
         long id_actual;
@@ -331,6 +1285,7 @@ void buscar_registro_por_id(long id_buscado, char* resultado, size_t resultado_l
         }
     }
     if (!encontrado) snprintf(resultado, resultado_len, "ERROR|ID %ld no encontrado.", id_buscado);
+    metricas_sumar(&metricas->bytes_leidos, ftell(archivo));
     fclose(archivo);
 }
 void actualizar_registro_por_id(long id_buscado, int indice_campo, const char* nuevo_valor, char* respuesta, size_t respuesta_len) {
@@ -340,11 +1295,20 @@ void actualizar_registro_por_id(long id_buscado, int indice_campo, const char* n
     char linea[TAMANIO_BUFFER]; 
     bool encontrado = false;
     bool modificacion_valida = true;
+    off_t posicion = 0; // Bytes escritos en el temporal (ftello haría una llamada al sistema por línea).
+    char fila_nueva[TAMANIO_BUFFER * 2];
+    off_t tamanio_vigente = indice_invalidar();
 
-    if (fgets(linea, sizeof(linea), original)) fputs(linea, temporal);
+    if (fgets(linea, sizeof(linea), original)) {
+        fputs(linea, temporal);
+        posicion = strlen(linea);
+    }
     while (fgets(linea, sizeof(linea), original)) {
         long id_actual;
-        if (sscanf(linea, "%ld,", &id_actual) == 1 && id_actual == id_buscado) {
+        bool tiene_id = sscanf(linea, "%ld,", &id_actual) == 1;
+        // Los desplazamientos del índice pasan a ser los del archivo nuevo.
+        if (tiene_id) indice_registrar(id_actual, posicion);
+        if (tiene_id && id_actual == id_buscado) {
             encontrado = true;
             char partes[4][256];
             if (sscanf(linea, "%[^,],%[^,],%[^,],%[^\n]", partes[0], partes[1], partes[2], partes[3]) == 4) {
@@ -371,96 +1335,493 @@ void actualizar_registro_por_id(long id_buscado, int indice_campo, const char* n
                     if (indice_campo > 0 && indice_campo < 4) {
                         snprintf(partes[indice_campo], 256, "%s", nuevo_valor);
                     }
-                    fprintf(temporal, "%s,%s,%s,%s\n", partes[0], partes[1], partes[2], partes[3]);
+                    snprintf(fila_nueva, sizeof(fila_nueva), "%s,%s,%s,%s\n", partes[0], partes[1], partes[2], partes[3]);
+                    fputs(fila_nueva, temporal);
+                    posicion += strlen(fila_nueva);
                 } else {
                     fputs(linea, temporal); // Si no es válido, escribe la línea original.
+                    posicion += strlen(linea);
                 }
             }
         } else {
             fputs(linea, temporal);
+            posicion += strlen(linea);
         }
     }
+    metricas_sumar(&metricas->bytes_leidos, ftell(original));
+    metricas_sumar(&metricas->bytes_escritos, ftell(temporal));
     fclose(original); fclose(temporal);
     
     if (encontrado && modificacion_valida) {
-        remove(NOMBRE_ARCHIVO_BD); rename(NOMBRE_ARCHIVO_TEMP, NOMBRE_ARCHIVO_BD);
-        snprintf(respuesta, respuesta_len, "Registro %ld actualizado.", id_buscado);
+        if (reemplazar_base_de_datos()) {
+            registrar_cambio("P|%s", fila_nueva);
+            snprintf(respuesta, respuesta_len, "Registro %ld actualizado.", id_buscado);
+        } else {
+            remove(NOMBRE_ARCHIVO_TEMP);
+            construir_indice(); // El índice ya apuntaba al archivo que no se pudo instalar.
+            snprintf(respuesta, respuesta_len, "ERROR|No se pudo reemplazar la base de datos.");
+        }
     } else if (encontrado && !modificacion_valida) {
-        // La respuesta ya tiene el mensaje de error de validación.
+        // La respuesta ya tiene el mensaje de error de validación. El temporal era igual
+        // al CSV, así que los desplazamientos siguen valiendo.
         remove(NOMBRE_ARCHIVO_TEMP);
+        indice->tamanio = tamanio_vigente;
     } else { // No encontrado
         remove(NOMBRE_ARCHIVO_TEMP);
+        indice->tamanio = tamanio_vigente;
         snprintf(respuesta, respuesta_len, "ERROR|ID %ld no encontrado.", id_buscado);
     }
 }
 
-// Busca el ID más alto en el archivo para determinar el siguiente.
-long obtener_max_id() {
+// Mapea el índice primario sobre output.idx, compartido por todos los procesos. El
+// archivo se extiende a la capacidad completa como archivo disperso y MAP_NORESERVE hace
+// que solo ocupen memoria y disco las páginas de los IDs que efectivamente existen. Si
+// el archivo no se puede usar, el índice vive solo en memoria.
+bool crear_indice() {
+    size_t tamanio = sizeof(IndicePrimario) + CAPACIDAD_INDICE * sizeof(off_t);
+    fd_indice = open(NOMBRE_ARCHIVO_INDICE, O_RDWR | O_CREAT, 0666);
+    if (fd_indice >= 0 && ftruncate(fd_indice, tamanio) == 0) {
+        indice = mmap(NULL, tamanio, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd_indice, 0);
+        if (indice != MAP_FAILED) return true;
+    }
+    fprintf(stderr, "Aviso: No se pudo usar %s (%s); el índice no se guardará.\n", NOMBRE_ARCHIVO_INDICE, strerror(errno));
+    if (fd_indice >= 0) close(fd_indice);
+    fd_indice = -1;
+    indice = mmap(NULL, tamanio, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (indice == MAP_FAILED) {
+        indice = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Suma de control FNV-1a del primer y el último MB del CSV. Detecta un archivo
+// reemplazado o editado sin recorrerlo entero. Es una heurística: una edición en el medio
+// que conserve el tamaño y la fecha de modificación (por ejemplo, con touch -d) no se
+// detecta, y el snapshot se usaría con desplazamientos que ya no corresponden.
+uint64_t suma_control_csv(int fd, off_t tamanio) {
+    static char bloque[TAMANIO_MUESTRA_SUMA];
+    uint64_t suma = 14695981039346656037ULL;
+    off_t posiciones[2] = {0, tamanio > TAMANIO_MUESTRA_SUMA ? tamanio - TAMANIO_MUESTRA_SUMA : 0};
+    for (int i = 0; i < 2; i++) {
+        ssize_t leidos = pread(fd, bloque, sizeof(bloque), posiciones[i]);
+        for (ssize_t j = 0; j < leidos; j++) {
+            suma ^= (unsigned char)bloque[j];
+            suma *= 1099511628211ULL;
+        }
+    }
+    return suma;
+}
+
+// Obtiene la etiqueta (tamaño, fecha de modificación y suma) del CSV actual.
+bool etiqueta_csv(int64_t* tamanio, int64_t* mtime_ns, uint64_t* suma) {
+    int fd = open(NOMBRE_ARCHIVO_BD, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat estado;
+    bool ok = fstat(fd, &estado) == 0;
+    if (ok) {
+        *tamanio = estado.st_size;
+        *mtime_ns = (int64_t)estado.st_mtim.tv_sec * 1000000000 + estado.st_mtim.tv_nsec;
+        *suma = suma_control_csv(fd, estado.st_size);
+    }
+    close(fd);
+    return ok;
+}
+
+// Usa el snapshot de output.idx si fue guardado en un cierre ordenado y su etiqueta
+// coincide con el CSV actual (ver los límites de la etiqueta en suma_control_csv). En cualquier caso lo marca como en uso: si el servidor
+// termina de forma abrupta, el próximo inicio lo descarta y reconstruye el índice.
+bool cargar_snapshot_indice() {
+    if (fd_indice < 0) return false;
+    int64_t tamanio, mtime_ns;
+    uint64_t suma;
+    bool valido = memcmp(indice->magia, MAGIA_INDICE, sizeof(indice->magia)) == 0
+               && indice->version == VERSION_INDICE && indice->limpio == 1
+               && etiqueta_csv(&tamanio, &mtime_ns, &suma)
+               && tamanio == indice->tamanio_csv && mtime_ns == indice->mtime_ns && suma == indice->suma_csv;
+    if (!valido) {
+        // Descarta el contenido viejo: el archivo vuelve a estar vacío y disperso.
+        if (ftruncate(fd_indice, 0) != 0 || ftruncate(fd_indice, sizeof(IndicePrimario) + CAPACIDAD_INDICE * sizeof(off_t)) != 0) {
+            memset(indice, 0, sizeof(IndicePrimario));
+        }
+    }
+    memcpy(indice->magia, MAGIA_INDICE, sizeof(indice->magia));
+    indice->version = VERSION_INDICE;
+    indice->limpio = 0;
+    msync(indice, sizeof(IndicePrimario), MS_SYNC);
+    if (valido) indice_marcar_vigente();
+    return valido;
+}
+
+// Guarda el índice como snapshot al cerrar el servidor. Requiere el bloqueo exclusivo.
+// Si el CSV no es el que describe el índice (por ejemplo, quedó una transacción a medias),
+// el snapshot queda marcado como en uso y el próximo inicio reconstruye.
+void guardar_snapshot_indice() {
+    if (fd_indice < 0) return;
+    if (!indice_vigente() || !etiqueta_csv(&indice->tamanio_csv, &indice->mtime_ns, &indice->suma_csv)) {
+        printf("Índice no guardado: el CSV cambió por fuera del servidor.\n");
+        return;
+    }
+    long usados = indice->proximo_id < CAPACIDAD_INDICE ? indice->proximo_id : CAPACIDAD_INDICE;
+    size_t tamanio = sizeof(IndicePrimario) + usados * sizeof(off_t);
+    // Primero los desplazamientos y después la cabecera marcada como limpia, para que
+    // un corte en medio nunca deje un snapshot limpio incompleto.
+    msync(indice, tamanio, MS_SYNC);
+    indice->limpio = 1;
+    msync(indice, sizeof(IndicePrimario), MS_SYNC);
+    // En disco solo queda la parte usada; el próximo inicio lo vuelve a extender.
+    if (ftruncate(fd_indice, tamanio) == 0) fsync(fd_indice);
+    printf("Índice guardado en %s: %ld registros.\n", NOMBRE_ARCHIVO_INDICE, indice->registros);
+}
+
+// Vacía el índice (por ejemplo, antes de reconstruirlo o al reiniciar la base).
+void vaciar_indice() {
+    if (indice->proximo_id > 0) {
+        long usados = indice->proximo_id < CAPACIDAD_INDICE ? indice->proximo_id : CAPACIDAD_INDICE;
+        // Devuelve las páginas al sistema; al volver a leerlas valen cero.
+        if (madvise(indice->desplazamientos, usados * sizeof(off_t), MADV_REMOVE) != 0) {
+            memset(indice->desplazamientos, 0, usados * sizeof(off_t));
+        }
+    }
+    indice->proximo_id = 0;
+    indice->registros = 0;
+}
+
+// Vuelca al índice compartido los tramos de `desplazamientos` que tienen alguna entrada.
+// Con output.idx se escribe con pwrite por tramos: escribir página a página sobre el
+// mapeo del archivo disperso cuesta un fallo de página y una asignación de bloques por
+// página, mucho más que el recorrido del CSV.
+void volcar_indice(const off_t* desplazamientos, const uint8_t* tramos_usados, long usados) {
+    for (long tramo = 0; tramo * ENTRADAS_TRAMO_INDICE < usados; tramo++) {
+        if (!(tramos_usados[tramo / 8] & (1 << (tramo % 8)))) continue;
+        long desde = tramo * ENTRADAS_TRAMO_INDICE;
+        long cantidad = usados - desde < ENTRADAS_TRAMO_INDICE ? usados - desde : ENTRADAS_TRAMO_INDICE;
+        off_t posicion = (off_t)(offsetof(IndicePrimario, desplazamientos) + desde * sizeof(off_t));
+        size_t bytes = cantidad * sizeof(off_t);
+        if (fd_indice < 0 || pwrite(fd_indice, desplazamientos + desde, bytes, posicion) != (ssize_t)bytes) {
+            memcpy(indice->desplazamientos + desde, desplazamientos + desde, bytes);
+        }
+    }
+}
+
+// Reconstruye el índice recorriendo el CSV completo. Los desplazamientos se arman en un
+// buffer privado que crece según el mayor ID visto y al final se copian al índice
+// compartido. Si el buffer no puede crecer, lo armado hasta ahí se vuelca y el resto se
+// registra directamente en el índice compartido. Devuelve false si no se pudo leer.
+bool construir_indice() {
+    uint8_t* tramos_usados = calloc(CAPACIDAD_INDICE / ENTRADAS_TRAMO_INDICE / 8, 1);
     FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "r");
-    if (!archivo) return -1;
+    if (!tramos_usados || !archivo) {
+        free(tramos_usados);
+        if (archivo) fclose(archivo);
+        vaciar_indice();
+        indice->proximo_id = PROXIMO_ID_DESCONOCIDO;
+        indice->tamanio = -1;
+        return false;
+    }
+    off_t* desplazamientos = NULL;
+    long capacidad = 0, proximo_id = 0, registros = 0;
+    bool directo = false; // Sin buffer: se escribe en el índice compartido.
+    vaciar_indice();
     char linea[TAMANIO_BUFFER];
-    long max_id = -1;
-    long id_actual;
     // Salta la cabecera.
-    if (fgets(linea, sizeof(linea), archivo) == NULL) {
-        fclose(archivo);
-        return 0;
-    }
-    while (fgets(linea, sizeof(linea), archivo)) {
-        if (sscanf(linea, "%ld,", &id_actual) == 1) {
-            if (id_actual > max_id) {
-                max_id = id_actual;
+    if (fgets(linea, sizeof(linea), archivo) != NULL) {
+        // La posición se lleva sumando largos: ftello haría una llamada al sistema por línea.
+        off_t desplazamiento = strlen(linea);
+        while (fgets(linea, sizeof(linea), archivo)) {
+            long id_actual;
+            if (sscanf(linea, "%ld,", &id_actual) == 1 && id_actual >= 0) {
+                if (!directo && id_actual < CAPACIDAD_INDICE && id_actual >= capacidad) {
+                    long nueva_capacidad = capacidad ? capacidad : ENTRADAS_TRAMO_INDICE;
+                    while (nueva_capacidad <= id_actual) nueva_capacidad *= 2;
+                    if (nueva_capacidad > CAPACIDAD_INDICE) nueva_capacidad = CAPACIDAD_INDICE;
+                    off_t* nuevo = realloc(desplazamientos, nueva_capacidad * sizeof(off_t));
+                    if (nuevo) {
+                        memset(nuevo + capacidad, 0, (nueva_capacidad - capacidad) * sizeof(off_t));
+                        desplazamientos = nuevo;
+                        capacidad = nueva_capacidad;
+                    } else {
+                        volcar_indice(desplazamientos, tramos_usados, proximo_id < capacidad ? proximo_id : capacidad);
+                        indice->proximo_id = proximo_id;
+                        indice->registros = registros;
+                        free(desplazamientos);
+                        desplazamientos = NULL;
+                        directo = true;
+                    }
+                }
+                if (directo) {
+                    indice_registrar(id_actual, desplazamiento);
+                } else {
+                    if (id_actual >= proximo_id) proximo_id = id_actual + 1;
+                    if (id_actual < CAPACIDAD_INDICE) {
+                        if (desplazamientos[id_actual] == 0) registros++;
+                        desplazamientos[id_actual] = desplazamiento;
+                        long tramo = id_actual / ENTRADAS_TRAMO_INDICE;
+                        tramos_usados[tramo / 8] |= (uint8_t)(1 << (tramo % 8));
+                    }
+                }
             }
+            desplazamiento += strlen(linea);
         }
     }
+    metricas_sumar(&metricas->bytes_leidos, ftell(archivo));
     fclose(archivo);
-    return max_id;
+
+    if (!directo) {
+        volcar_indice(desplazamientos, tramos_usados, proximo_id < capacidad ? proximo_id : capacidad);
+        indice->proximo_id = proximo_id;
+        indice->registros = registros;
+    }
+    free(desplazamientos);
+    free(tramos_usados);
+    indice_marcar_vigente();
+    return true;
 }
 
-// Agrega un nuevo registro al final del archivo.
-void agregar_registro(const char* datos_registro, char* respuesta, size_t respuesta_len) {
-    char nombre_producto[256];
+// Indica si el CSV sigue siendo el mismo que describe el índice.
+bool indice_vigente() {
+    struct stat estado;
+    if (stat(NOMBRE_ARCHIVO_BD, &estado) != 0) return false;
+    return estado.st_dev == indice->dispositivo && estado.st_ino == indice->inodo && estado.st_size == indice->tamanio;
+}
+
+// Registra el CSV actual como el descrito por el índice, después de modificarlo.
+// Requiere el bloqueo exclusivo.
+void indice_marcar_vigente() {
+    struct stat estado;
+    // Un índice que no se pudo construir no describe ningún archivo: sigue sin ser vigente
+    // hasta que una reconstrucción funcione.
+    if (indice->proximo_id == PROXIMO_ID_DESCONOCIDO || stat(NOMBRE_ARCHIVO_BD, &estado) != 0) {
+        indice->inodo = 0;
+        indice->tamanio = -1;
+        return;
+    }
+    indice->dispositivo = estado.st_dev;
+    indice->inodo = estado.st_ino;
+    indice->tamanio = estado.st_size;
+}
+
+// Marca el índice como desactualizado antes de reescribir el CSV: mientras dure la
+// reescritura, los desplazamientos son los del temporal, y si el proceso muere antes del
+// rename() el CSV viejo (mismo inodo y tamaño) no debe parecer descrito por ellos. El
+// COMMIT lo vuelve a marcar vigente. Devuelve el tamaño anterior, para restaurarlo si la
+// reescritura no cambió nada. Requiere el bloqueo exclusivo.
+off_t indice_invalidar() {
+    off_t anterior = indice->tamanio;
+    indice->tamanio = -1;
+    return anterior;
+}
+
+// Registra (o actualiza) el desplazamiento de un ID. Requiere el bloqueo exclusivo.
+void indice_registrar(long id, off_t desplazamiento) {
+    if (id < 0 || indice->proximo_id == PROXIMO_ID_DESCONOCIDO) return;
+    if (id >= indice->proximo_id) indice->proximo_id = id + 1;
+    if (id >= CAPACIDAD_INDICE) return; // Fuera del índice: GET recurre al recorrido secuencial.
+    if (indice->desplazamientos[id] == 0) indice->registros++;
+    indice->desplazamientos[id] = desplazamiento;
+}
+
+// Quita un ID del índice. Requiere el bloqueo exclusivo.
+void indice_eliminar(long id) {
+    if (id < 0 || id >= CAPACIDAD_INDICE || indice->desplazamientos[id] == 0) return;
+    indice->desplazamientos[id] = 0;
+    indice->registros--;
+}
+
+// Devuelve el desplazamiento de un ID, o 0 si no existe.
+off_t indice_buscar(long id) {
+    if (id < 0 || id >= CAPACIDAD_INDICE) return 0;
+    return indice->desplazamientos[id];
+}
+
+// Devuelve el próximo ID libre a partir del contador que mantiene el índice. Si el índice
+// no se pudo construir, busca el ID máximo recorriendo el CSV, para no repetir IDs.
+long obtener_proximo_id() {
+    if (indice->proximo_id != PROXIMO_ID_DESCONOCIDO) return indice->proximo_id;
+    long proximo_id = 0;
+    FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "r");
+    if (!archivo) return 0;
+    char linea[TAMANIO_BUFFER];
+    if (fgets(linea, sizeof(linea), archivo) != NULL) {
+        while (fgets(linea, sizeof(linea), archivo)) {
+            long id_actual;
+            if (sscanf(linea, "%ld,", &id_actual) == 1 && id_actual >= proximo_id) proximo_id = id_actual + 1;
+        }
+    }
+    metricas_sumar(&metricas->bytes_leidos, ftell(archivo));
+    fclose(archivo);
+    return proximo_id;
+}
+
+// Valida los datos de un registro "NOMBRE,CANTIDAD,PRECIO". Si son correctos devuelve
+// true y completa los campos; si no, deja el mensaje de error en la respuesta.
+bool validar_registro(const char* datos_registro, char* nombre_producto, int* cantidad, double* precio, char* respuesta, size_t respuesta_len) {
     char cantidad_str[50];
     char precio_str[50];
-    double precio;
-    int cantidad;
 
     // Parsea los datos del registro: "NOMBRE,CANTIDAD,PRECIO"
     if (sscanf(datos_registro, "%255[^,],%49[^,],%49s", nombre_producto, cantidad_str, precio_str) != 3) {
         snprintf(respuesta, respuesta_len, "ERROR|Formato incorrecto. Uso: ADD <NOMBRE_PRODUCTO>,<CANTIDAD>,<PRECIO>");
-        return;
+        return false;
     }
 
     // Valida que la cantidad no sea decimal y que el precio no use comas.
     if (strchr(cantidad_str, '.') != NULL || strchr(cantidad_str, ',') != NULL) {
         snprintf(respuesta, respuesta_len, "ERROR|La cantidad no puede ser un número decimal.");
-        return;
+        return false;
     }
     if (strchr(precio_str, ',') != NULL) {
         snprintf(respuesta, respuesta_len, "ERROR|El precio debe usar un punto (.) como separador decimal, no una coma (,).");
-        return;
+        return false;
     }
-    cantidad = atoi(cantidad_str);
-    precio = atof(precio_str);
+    *cantidad = atoi(cantidad_str);
+    *precio = atof(precio_str);
 
     // Valida que los datos no sean negativos.
-    if (cantidad < 0 || precio < 0.0) {
+    if (*cantidad < 0 || *precio < 0.0) {
         snprintf(respuesta, respuesta_len, "ERROR|La cantidad y el precio no pueden ser negativos.");
+        return false;
+    }
+    return true;
+}
+
+// Agrega un nuevo registro al final del archivo.
+void agregar_registro(const char* datos_registro, char* respuesta, size_t respuesta_len) {
+    char nombre_producto[256];
+    double precio;
+    int cantidad;
+
+    if (!validar_registro(datos_registro, nombre_producto, &cantidad, &precio, respuesta, respuesta_len)) {
         return;
     }
 
-    long nuevo_id = obtener_max_id() + 1;
+    long nuevo_id = obtener_proximo_id();
     // Abre el archivo en modo "append" para añadir al final.
     FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "a");
     if (!archivo) {
         snprintf(respuesta, respuesta_len, "ERROR|No se pudo abrir la base de datos para escribir.");
         return;
     }
-    fprintf(archivo, "%ld,%s,%d,%.2f\n", nuevo_id, nombre_producto, cantidad, precio);
-    fclose(archivo);
+    fseeko(archivo, 0, SEEK_END);
+    off_t desplazamiento = ftello(archivo);
+    int escritos = fprintf(archivo, "%ld,%s,%d,%.2f\n", nuevo_id, nombre_producto, cantidad, precio);
+    if (escritos > 0) metricas_sumar(&metricas->bytes_escritos, escritos);
+    if (fclose(archivo) != 0 || escritos <= 0) {
+        snprintf(respuesta, respuesta_len, "ERROR|No se pudo escribir en la base de datos.");
+        return;
+    }
+    indice_registrar(nuevo_id, desplazamiento);
+    registrar_cambio("P|%ld,%s,%d,%.2f\n", nuevo_id, nombre_producto, cantidad, precio);
     snprintf(respuesta, respuesta_len, "Registro agregado con ID %ld.", nuevo_id);
 }
 
+// Recibe filas "NOMBRE,CANTIDAD,PRECIO" hasta la línea END, las valida con las mismas reglas
+// que ADD y escribe todas las aceptadas con un único append. Devuelve <= 0 si el cliente
+// se desconectó antes de END (en ese caso no se escribe nada).
+int agregar_registros_en_lote(LectorSocket* lector, bool en_transaccion, char* respuesta, size_t respuesta_len) {
+    char linea[TAMANIO_BUFFER];
+    char error[TAMANIO_BUFFER];  // Motivo del primer rechazo.
+    char motivo[TAMANIO_BUFFER]; // Motivo del rechazo de la fila actual.
+    char nombre_producto[256];
+    double precio;
+    int cantidad;
+    long aceptados = 0, rechazados = 0;
+    long primer_rechazo = 0; // Número de fila (desde 1) del primer rechazo.
+    long id_inicial = en_transaccion ? obtener_proximo_id() : 0;
+
+    // Buffer creciente con todas las filas aceptadas, ya formateadas.
+    char* lote = NULL;
+    size_t lote_largo = 0, lote_capacidad = 0;
+    error[0] = '\0';
+
+    while (true) {
+        int estado = leer_linea(lector, linea, sizeof(linea));
+        if (estado <= 0) {
+            free(lote);
+            return estado;
+        }
+        if (strcmp(linea, "END") == 0) break;
+        if (!en_transaccion) continue;
+
+        if (!validar_registro(linea, nombre_producto, &cantidad, &precio, motivo, sizeof(motivo))) {
+            if (rechazados++ == 0) {
+                primer_rechazo = aceptados + rechazados;
+                snprintf(error, sizeof(error), "%s", motivo);
+            }
+            continue;
+        }
+        // Asegura espacio para la fila formateada.
+        if (lote_capacidad - lote_largo < TAMANIO_BUFFER) {
+            size_t nueva_capacidad = lote_capacidad ? lote_capacidad * 2 : 64 * TAMANIO_BUFFER;
+            char* nuevo = realloc(lote, nueva_capacidad);
+            if (!nuevo) {
+                free(lote);
+                snprintf(respuesta, respuesta_len, "ERROR|Memoria insuficiente para el lote.");
+                // Descarta el resto de las filas para mantener el protocolo sincronizado.
+                while ((estado = leer_linea(lector, linea, sizeof(linea))) > 0 && strcmp(linea, "END") != 0) {}
+                return estado;
+            }
+            lote = nuevo;
+            lote_capacidad = nueva_capacidad;
+        }
+        lote_largo += snprintf(lote + lote_largo, lote_capacidad - lote_largo, "%ld,%s,%d,%.2f\n",
+                               id_inicial + aceptados, nombre_producto, cantidad, precio);
+        aceptados++;
+    }
+
+    if (!en_transaccion) {
+        snprintf(respuesta, respuesta_len, "ERROR|Operación requiere una transacción.");
+        return 1;
+    }
+
+    if (aceptados > 0) {
+        FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "a");
+        off_t base = 0;
+        if (archivo && fseeko(archivo, 0, SEEK_END) == 0) base = ftello(archivo);
+        bool escrito = archivo && fwrite(lote, 1, lote_largo, archivo) == lote_largo;
+        if (archivo && fclose(archivo) != 0) escrito = false;
+        if (escrito) {
+            metricas_sumar(&metricas->bytes_escritos, lote_largo);
+            indexar_filas(lote, lote_largo, base, id_inicial);
+            registrar_filas_cambiadas(lote, lote_largo);
+        }
+        free(lote);
+        if (!escrito) {
+            snprintf(respuesta, respuesta_len, "ERROR|No se pudo escribir el lote en la base de datos.");
+            return 1;
+        }
+    }
+
+    if (rechazados > 0) {
+        snprintf(respuesta, respuesta_len, "BULK ADD: %ld aceptados, %ld rechazados (primer rechazo en fila %ld: %s).",
+                 aceptados, rechazados, primer_rechazo, error + strlen("ERROR|"));
+    } else if (aceptados > 0) {
+        snprintf(respuesta, respuesta_len, "BULK ADD: %ld aceptados, 0 rechazados. IDs %ld a %ld.",
+                 aceptados, id_inicial, id_inicial + aceptados - 1);
+    } else {
+        snprintf(respuesta, respuesta_len, "BULK ADD: 0 aceptados, 0 rechazados.");
+    }
+    return 1;
+}
+
+// Indexa filas consecutivas ya escritas a partir del desplazamiento base. Si id_inicial
+// es >= 0 las filas llevan IDs correlativos desde ese valor; si no, se lee el ID de cada una.
+void indexar_filas(const char* filas, size_t largo, off_t base, long id_inicial) {
+    size_t posicion = 0;
+    long id = id_inicial;
+    while (posicion < largo) {
+        const char* fin = memchr(filas + posicion, '\n', largo - posicion);
+        size_t largo_fila = fin ? (size_t)(fin - (filas + posicion)) + 1 : largo - posicion;
+        if (id_inicial >= 0) {
+            indice_registrar(id++, base + (off_t)posicion);
+        } else {
+            long id_fila;
+            if (sscanf(filas + posicion, "%ld,", &id_fila) == 1) indice_registrar(id_fila, base + (off_t)posicion);
+        }
+        posicion += largo_fila;
+    }
+}
+
 // Elimina un registro usando la estrategia de archivo temporal.
 void eliminar_registro_por_id(long id_buscado, char* respuesta, size_t respuesta_len) {
     FILE* original = fopen(NOMBRE_ARCHIVO_BD, "r");
@@ -474,26 +1835,661 @@ void eliminar_registro_por_id(long id_buscado, char* respuesta, size_t respuesta
     char linea[TAMANIO_BUFFER];
     long id_actual;
     bool encontrado = false;
+    off_t posicion = 0; // Bytes escritos en el temporal.
+    off_t tamanio_vigente = indice_invalidar();
     // Copia la cabecera.
     if (fgets(linea, sizeof(linea), original)) {
         fputs(linea, temporal);
+        posicion = strlen(linea);
     }
     // Procesa cada línea del archivo original.
     while (fgets(linea, sizeof(linea), original)) {
-        if (sscanf(linea, "%ld,", &id_actual) == 1 && id_actual == id_buscado) {
+        bool tiene_id = sscanf(linea, "%ld,", &id_actual) == 1;
+        if (tiene_id && id_actual == id_buscado) {
             encontrado = true;
             // No copia la línea al archivo temporal, eliminándola efectivamente.
         } else {
+            // Las filas siguientes a la eliminada se desplazan en el archivo nuevo.
+            if (tiene_id) indice_registrar(id_actual, posicion);
             fputs(linea, temporal);
+            posicion += strlen(linea);
         }
     }
+    metricas_sumar(&metricas->bytes_leidos, ftell(original));
+    metricas_sumar(&metricas->bytes_escritos, ftell(temporal));
     fclose(original); fclose(temporal);
     if (encontrado) {
-        remove(NOMBRE_ARCHIVO_BD);
-        rename(NOMBRE_ARCHIVO_TEMP, NOMBRE_ARCHIVO_BD);
-        snprintf(respuesta, respuesta_len, "Registro %ld eliminado.", id_buscado);
+        if (reemplazar_base_de_datos()) {
+            indice_eliminar(id_buscado);
+            registrar_cambio("D|%ld\n", id_buscado);
+            snprintf(respuesta, respuesta_len, "Registro %ld eliminado.", id_buscado);
+        } else {
+            remove(NOMBRE_ARCHIVO_TEMP);
+            construir_indice();
+            snprintf(respuesta, respuesta_len, "ERROR|No se pudo reemplazar la base de datos.");
+        }
     } else {
         remove(NOMBRE_ARCHIVO_TEMP);
+        indice->tamanio = tamanio_vigente; // El temporal era igual al CSV.
         snprintf(respuesta, respuesta_len, "ERROR|ID %ld no encontrado para eliminar.", id_buscado);
     }
-}
\ No newline at end of file
+}
+
+// Verifica que una fila recibida por la ingesta empiece con un ID numérico.
+bool fila_ingesta_valida(const char* linea) {
+    const char* p = linea;
+    while (isdigit((unsigned char)*p)) p++;
+    return p > linea && *p == ',';
+}
+
+// Atiende el flujo de registros que envía el coordinador del generador. La primera
+// línea es la cabecera del CSV: la base se reinicia con ella, igual que cuando el
+// generador crea output.csv. Luego cada fila se agrega en lotes, tomando el bloqueo
+// exclusivo solo mientras se escribe e indexa cada lote, de modo que los clientes
+// pueden consultar los datos mientras la generación continúa. "FIN" cierra el flujo.
+void manejar_ingesta(int socket_ingesta) {
+    LectorSocket* lector = malloc(sizeof(LectorSocket));
+    char* lote = malloc((size_t)MAX_FILAS_LOTE_INGESTA * TAMANIO_BUFFER);
+    int fd_bloqueo = open(NOMBRE_ARCHIVO_BLOQUEO, O_RDWR | O_CREAT, 0666);
+    char linea[TAMANIO_BUFFER];
+    char respuesta[TAMANIO_BUFFER];
+    long aceptados = 0, rechazados = 0;
+    bool completo = false;
+    if (!lector || !lote || fd_bloqueo < 0) {
+        snprintf(respuesta, sizeof(respuesta), "ERROR|No se pudo preparar la ingesta.\n");
+        enviar_todo(socket_ingesta, respuesta, strlen(respuesta));
+        free(lector); free(lote);
+        if (fd_bloqueo >= 0) close(fd_bloqueo);
+        close(socket_ingesta);
+        return;
+    }
+    lector_inicializar(lector, socket_ingesta);
+
+    // Cabecera: reinicia la base con un archivo que solo la contiene.
+    if (leer_linea(lector, linea, sizeof(linea)) <= 0) {
+        free(lector); free(lote); close(fd_bloqueo); close(socket_ingesta);
+        return;
+    }
+    flock(fd_bloqueo, LOCK_EX);
+    FILE* temporal = fopen(NOMBRE_ARCHIVO_TEMP, "w");
+    bool reiniciada = temporal && fprintf(temporal, "%s\n", linea) > 0;
+    if (temporal && fclose(temporal) != 0) reiniciada = false;
+    reiniciada = reiniciada && reemplazar_base_de_datos();
+    if (reiniciada) {
+        vaciar_indice();
+        indice_marcar_vigente();
+        registrar_cambio("R|%s\n", linea);
+        publicar_cambios();
+    }
+    flock(fd_bloqueo, LOCK_UN);
+    if (!reiniciada) {
+        remove(NOMBRE_ARCHIVO_TEMP);
+        snprintf(respuesta, sizeof(respuesta), "ERROR|No se pudo reiniciar la base de datos.\n");
+        enviar_todo(socket_ingesta, respuesta, strlen(respuesta));
+        free(lector); free(lote); close(fd_bloqueo); close(socket_ingesta);
+        return;
+    }
+
+    bool error_escritura = false;
+    while (!completo && !error_escritura) {
+        // Arma un lote con la línea siguiente más las que ya estén en el buffer, para
+        // no retener el bloqueo esperando datos de la red.
+        size_t lote_largo = 0;
+        int filas = 0;
+        int estado;
+        do {
+            estado = leer_linea(lector, linea, sizeof(linea));
+            if (estado <= 0) break;
+            if (strcmp(linea, "FIN") == 0) {
+                completo = true;
+                break;
+            }
+            if (!fila_ingesta_valida(linea)) {
+                rechazados++;
+                continue;
+            }
+            size_t largo = strlen(linea);
+            memcpy(lote + lote_largo, linea, largo);
+            lote[lote_largo + largo] = '\n';
+            lote_largo += largo + 1;
+            filas++;
+        } while (filas < MAX_FILAS_LOTE_INGESTA && lector_tiene_linea(lector));
+
+        if (lote_largo > 0) {
+            flock(fd_bloqueo, LOCK_EX);
+            FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "a");
+            off_t base = 0;
+            if (archivo && fseeko(archivo, 0, SEEK_END) == 0) base = ftello(archivo);
+            bool escrito = archivo && fwrite(lote, 1, lote_largo, archivo) == lote_largo;
+            if (archivo && fclose(archivo) != 0) escrito = false;
+            if (escrito) {
+                indexar_filas(lote, lote_largo, base, -1);
+                indice_marcar_vigente();
+                registrar_filas_cambiadas(lote, lote_largo);
+                publicar_cambios();
+            }
+            flock(fd_bloqueo, LOCK_UN);
+            if (escrito) {
+                metricas_sumar(&metricas->bytes_escritos, lote_largo);
+                aceptados += filas;
+            } else {
+                error_escritura = true;
+            }
+        }
+        if (estado <= 0) break; // El generador se desconectó sin enviar FIN.
+    }
+
+    if (error_escritura) {
+        snprintf(respuesta, sizeof(respuesta), "ERROR|No se pudo escribir en la base de datos (%ld registros ingresados).\n", aceptados);
+    } else if (completo) {
+        // Con durabilidad activada, la ingesta se confirma recién cuando está en disco.
+        bool durable = true;
+        if (modo_durabilidad != DURABILIDAD_NINGUNA) {
+            flock(fd_bloqueo, LOCK_SH);
+            durable = sincronizar_base_de_datos();
+            flock(fd_bloqueo, LOCK_UN);
+        }
+        if (durable) {
+            snprintf(respuesta, sizeof(respuesta), "OK|%ld registros ingresados, %ld rechazados.\n", aceptados, rechazados);
+        } else {
+            snprintf(respuesta, sizeof(respuesta), "ERROR|%ld registros ingresados pero no se pudieron sincronizar a disco.\n", aceptados);
+        }
+    }
+    if (error_escritura || completo) enviar_todo(socket_ingesta, respuesta, strlen(respuesta));
+    printf("Ingesta finalizada: %ld registros, %ld rechazados%s.\n", aceptados, rechazados,
+           completo ? "" : " (incompleta)");
+    free(lector); free(lote);
+    close(fd_bloqueo);
+    close(socket_ingesta);
+}
+
+// Usa otro archivo CSV como base de datos. Los archivos auxiliares toman su nombre sin
+// la extensión (por ejemplo replica.csv -> replica.tmp, replica.lock, replica.idx y
+// replica.log), así dos servidores pueden compartir el mismo directorio.
+void configurar_archivos(const char* ruta_bd) {
+    static char temporal[PATH_MAX], bloqueo[PATH_MAX], indice_archivo[PATH_MAX], cambios[PATH_MAX];
+    size_t largo_base = strlen(ruta_bd);
+    if (largo_base > 4 && strcmp(ruta_bd + largo_base - 4, ".csv") == 0) largo_base -= 4;
+    snprintf(temporal, sizeof(temporal), "%.*s.tmp", (int)largo_base, ruta_bd);
+    snprintf(bloqueo, sizeof(bloqueo), "%.*s.lock", (int)largo_base, ruta_bd);
+    snprintf(indice_archivo, sizeof(indice_archivo), "%.*s.idx", (int)largo_base, ruta_bd);
+    snprintf(cambios, sizeof(cambios), "%.*s.log", (int)largo_base, ruta_bd);
+    NOMBRE_ARCHIVO_BD = ruta_bd;
+    NOMBRE_ARCHIVO_TEMP = temporal;
+    NOMBRE_ARCHIVO_BLOQUEO = bloqueo;
+    NOMBRE_ARCHIVO_INDICE = indice_archivo;
+    NOMBRE_ARCHIVO_CAMBIOS = cambios;
+}
+
+// Crea un proceso hijo que no ocupa un lugar de cliente (ingesta, replicación) y ejecuta
+// funcion(fd). SIGCHLD se bloquea hasta guardar el PID en destino, por si el hijo termina
+// enseguida y el manejador tiene que reconocerlo.
+pid_t lanzar_proceso_auxiliar(void (*funcion)(int), int fd, volatile pid_t* destino) {
+    sigset_t senales, anteriores;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &senales, &anteriores);
+    fflush(stdout); // Evita que el hijo repita lo pendiente en el buffer.
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &anteriores, NULL);
+        funcion(fd);
+        exit(0);
+    }
+    if (pid > 0) *destino = pid;
+    sigprocmask(SIG_SETMASK, &anteriores, NULL);
+    return pid;
+}
+
+// Hora actual (tiempo real) en microsegundos. A diferencia de tiempo_actual_us, se puede
+// comparar entre el primario y la réplica.
+uint64_t tiempo_real_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// Agrega bytes a los cambios pendientes de la transacción de este proceso.
+void agregar_a_cambios(const char* datos, size_t largo) {
+    if (cambios_capacidad - cambios_largo < largo) {
+        size_t nueva_capacidad = cambios_capacidad ? cambios_capacidad : 64 * TAMANIO_BUFFER;
+        while (nueva_capacidad - cambios_largo < largo) nueva_capacidad *= 2;
+        char* nuevo = realloc(cambios_pendientes, nueva_capacidad);
+        if (!nuevo) {
+            fprintf(stderr, "[PID: %d] Sin memoria para los cambios a replicar.\n", getpid());
+            return;
+        }
+        cambios_pendientes = nuevo;
+        cambios_capacidad = nueva_capacidad;
+    }
+    memcpy(cambios_pendientes + cambios_largo, datos, largo);
+    cambios_largo += largo;
+}
+
+// Anota un cambio para las réplicas. Sin --replicacion no hace nada.
+void registrar_cambio(const char* formato, ...) {
+    if (fd_registro_cambios < 0) return;
+    char linea[TAMANIO_BUFFER * 4];
+    va_list argumentos;
+    va_start(argumentos, formato);
+    int largo = vsnprintf(linea, sizeof(linea), formato, argumentos);
+    va_end(argumentos);
+    if (largo > 0 && (size_t)largo < sizeof(linea)) agregar_a_cambios(linea, largo);
+}
+
+// Anota como altas las filas (terminadas en '\n') escritas por BULK ADD o la ingesta.
+void registrar_filas_cambiadas(const char* filas, size_t largo) {
+    if (fd_registro_cambios < 0) return;
+    size_t posicion = 0;
+    while (posicion < largo) {
+        const char* fin = memchr(filas + posicion, '\n', largo - posicion);
+        size_t largo_fila = fin ? (size_t)(fin - (filas + posicion)) + 1 : largo - posicion;
+        agregar_a_cambios("P|", 2);
+        agregar_a_cambios(filas + posicion, largo_fila);
+        if (!fin) agregar_a_cambios("\n", 1);
+        posicion += largo_fila;
+    }
+}
+
+// Publica los cambios de la transacción en el registro, cerrados con "C", con un único
+// write() en modo append. Requiere el bloqueo exclusivo.
+void publicar_cambios() {
+    if (fd_registro_cambios < 0 || cambios_largo == 0) return;
+    agregar_a_cambios("C\n", 2);
+    // Sin réplicas conectadas nadie va a leer el registro: la próxima réplica parte de una
+    // copia base. Se vacía el archivo y el LSN avanza igual, para que siga siendo creciente.
+    if (__atomic_load_n(&metricas->replicas_conectadas, __ATOMIC_RELAXED) == 0) {
+        struct stat estado;
+        uint64_t base = metricas->registro_base + cambios_largo;
+        if (fstat(fd_registro_cambios, &estado) == 0 && estado.st_size > 0 && ftruncate(fd_registro_cambios, 0) == 0) {
+            base += (uint64_t)estado.st_size;
+        }
+        __atomic_store_n(&metricas->registro_base, base, __ATOMIC_RELAXED);
+        cambios_largo = 0;
+        return;
+    }
+    const char* datos = cambios_pendientes;
+    size_t restantes = cambios_largo;
+    while (restantes > 0) {
+        ssize_t escritos = write(fd_registro_cambios, datos, restantes);
+        if (escritos < 0 && errno == EINTR) continue;
+        if (escritos <= 0) {
+            perror("Registro de cambios");
+            break;
+        }
+        datos += escritos;
+        restantes -= (size_t)escritos;
+    }
+    cambios_largo = 0;
+}
+
+// Atiende a una réplica: le envía una copia base del CSV y después, en orden, todo lo que
+// se agrega al registro de cambios, junto con latidos "HB|<LSN>|<hora>" periódicos que le
+// permiten medir su retraso.
+void manejar_replicacion(int socket_replica) {
+    char linea[TAMANIO_BUFFER];
+    int fd_bloqueo = open(NOMBRE_ARCHIVO_BLOQUEO, O_RDWR | O_CREAT, 0666);
+    int fd_cambios = open(NOMBRE_ARCHIVO_CAMBIOS, O_RDONLY);
+    char* bloque = malloc(TAMANIO_BLOQUE_REPLICACION);
+
+    // Con el bloqueo compartido no hay transacciones a medias: el CSV y el registro de
+    // cambios corresponden al mismo punto. El bloqueo se suelta enseguida, porque el
+    // descriptor abierto sigue viendo ese CSV aunque luego crezca o se reemplace.
+    int fd_csv = -1;
+    struct stat estado_csv, estado_cambios;
+    if (fd_bloqueo >= 0 && fd_cambios >= 0 && bloque) {
+        flock(fd_bloqueo, LOCK_SH);
+        fd_csv = open(NOMBRE_ARCHIVO_BD, O_RDONLY);
+        if (fd_csv >= 0 && (fstat(fd_csv, &estado_csv) != 0 || fstat(fd_cambios, &estado_cambios) != 0)) {
+            close(fd_csv);
+            fd_csv = -1;
+        }
+        flock(fd_bloqueo, LOCK_UN);
+    }
+    if (fd_csv < 0) {
+        const char* msg = "ERROR|No se pudo preparar la copia base.\n";
+        enviar_todo(socket_replica, msg, strlen(msg));
+        if (fd_bloqueo >= 0) close(fd_bloqueo);
+        if (fd_cambios >= 0) close(fd_cambios);
+        free(bloque);
+        close(socket_replica);
+        return;
+    }
+
+    // El registro no se vacía mientras esta réplica está contada como conectada.
+    uint64_t base = __atomic_load_n(&metricas->registro_base, __ATOMIC_RELAXED);
+    uint64_t lsn = base + (uint64_t)estado_cambios.st_size;
+    snprintf(linea, sizeof(linea), "BASE|%llu|%lld\n", (unsigned long long)lsn, (long long)estado_csv.st_size);
+    bool conectada = enviar_todo(socket_replica, linea, strlen(linea));
+    off_t enviado = 0;
+    while (conectada && enviado < estado_csv.st_size) {
+        ssize_t bytes = sendfile(socket_replica, fd_csv, &enviado, estado_csv.st_size - enviado);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) conectada = false;
+    }
+    close(fd_csv);
+    close(fd_bloqueo);
+    if (conectada) {
+        metricas_sumar(&metricas->bytes_leidos, estado_csv.st_size);
+        printf("[Replicación] Copia base enviada: %lld bytes, LSN %llu.\n", (long long)estado_csv.st_size, (unsigned long long)lsn);
+        fflush(stdout);
+    }
+
+    // Sigue el registro de cambios. Solo se envían líneas completas.
+    uint64_t ultimo_latido = 0;
+    while (conectada) {
+        ssize_t leidos = pread(fd_cambios, bloque, TAMANIO_BLOQUE_REPLICACION, (off_t)(lsn - base));
+        const char* ultimo_salto = NULL;
+        for (ssize_t i = leidos - 1; i >= 0 && !ultimo_salto; i--) {
+            if (bloque[i] == '\n') ultimo_salto = bloque + i;
+        }
+        if (ultimo_salto) {
+            size_t largo = (size_t)(ultimo_salto - bloque) + 1;
+            conectada = enviar_todo(socket_replica, bloque, largo);
+            lsn += largo;
+        }
+        uint64_t ahora = tiempo_actual_us();
+        if (conectada && ahora - ultimo_latido >= INTERVALO_LATIDO_US) {
+            fstat(fd_cambios, &estado_cambios);
+            snprintf(linea, sizeof(linea), "HB|%llu|%llu\n", (unsigned long long)(base + estado_cambios.st_size), (unsigned long long)tiempo_real_us());
+            conectada = enviar_todo(socket_replica, linea, strlen(linea));
+            ultimo_latido = ahora;
+        }
+        // Sin novedades, espera un poco antes de volver a mirar el registro.
+        if (!ultimo_salto) usleep(ESPERA_CAMBIOS_US);
+    }
+    printf("[Replicación] Réplica desconectada en LSN %llu.\n", (unsigned long long)lsn);
+    free(bloque);
+    close(fd_cambios);
+    close(socket_replica);
+}
+
+// Conecta con el primario indicado en --replica-of.
+int conectar_primario() {
+    char host[256];
+    const char* separador = strrchr(replica_de, ':');
+    snprintf(host, sizeof(host), "%.*s", (int)(separador - replica_de), replica_de);
+    struct addrinfo pistas = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* direcciones;
+    if (getaddrinfo(host, separador + 1, &pistas, &direcciones) != 0) return -1;
+    int socket_primario = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_primario >= 0 && connect(socket_primario, direcciones->ai_addr, direcciones->ai_addrlen) < 0) {
+        close(socket_primario);
+        socket_primario = -1;
+    }
+    freeaddrinfo(direcciones);
+    return socket_primario;
+}
+
+// Recibe la copia base del primario y la instala como base de datos de la réplica.
+bool recibir_copia_base(LectorSocket* lector, int fd_bloqueo) {
+    char linea[TAMANIO_BUFFER];
+    unsigned long long lsn;
+    long long tamanio;
+    if (leer_linea(lector, linea, sizeof(linea)) <= 0) return false;
+    if (sscanf(linea, "BASE|%llu|%lld", &lsn, &tamanio) != 2) {
+        fprintf(stderr, "[Réplica] Respuesta inesperada del primario: %s\n", linea);
+        return false;
+    }
+    // Se descarga al archivo temporal, sin bloqueo: las consultas siguen con la copia anterior.
+    int fd_temporal = open(NOMBRE_ARCHIVO_TEMP, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd_temporal < 0) {
+        perror(NOMBRE_ARCHIVO_TEMP);
+        return false;
+    }
+    bool recibida = lector_copiar_a_fd(lector, fd_temporal, (uint64_t)tamanio);
+    if (close(fd_temporal) != 0) recibida = false;
+    if (!recibida) {
+        remove(NOMBRE_ARCHIVO_TEMP);
+        return false;
+    }
+    flock(fd_bloqueo, LOCK_EX);
+    bool instalada = reemplazar_base_de_datos();
+    if (instalada) construir_indice();
+    flock(fd_bloqueo, LOCK_UN);
+    if (!instalada) {
+        remove(NOMBRE_ARCHIVO_TEMP);
+        return false;
+    }
+    metricas_sumar(&metricas->bytes_escritos, (uint64_t)tamanio);
+    __atomic_store_n(&metricas->replica_lsn_primario, lsn, __ATOMIC_RELAXED);
+    __atomic_store_n(&metricas->replica_lsn_aplicado, lsn, __ATOMIC_RELAXED);
+    __atomic_store_n(&metricas->replica_marca_us, tiempo_real_us(), __ATOMIC_RELAXED);
+    printf("[Réplica] Copia base instalada: %lld bytes, %ld registros, LSN %llu.\n", tamanio, indice->registros, lsn);
+    fflush(stdout);
+    return true;
+}
+
+// Proceso aplicador de una réplica: descarga la copia base, aplica cada transacción del
+// primario con el bloqueo exclusivo y, si la conexión se corta, vuelve a empezar.
+void ejecutar_replica(int no_usado) {
+    (void)no_usado;
+    int fd_bloqueo = open(NOMBRE_ARCHIVO_BLOQUEO, O_RDWR | O_CREAT, 0666);
+    LectorSocket* lector = malloc(sizeof(LectorSocket));
+    char linea[TAMANIO_BUFFER];
+    if (fd_bloqueo < 0 || !lector) {
+        fprintf(stderr, "[Réplica] No se pudo iniciar el aplicador.\n");
+        return;
+    }
+    while (true) {
+        int socket_primario = conectar_primario();
+        if (socket_primario < 0) {
+            sleep(1);
+            continue;
+        }
+        __atomic_store_n(&metricas->replica_conectada, 1, __ATOMIC_RELAXED);
+        lector_inicializar(lector, socket_primario);
+
+        if (recibir_copia_base(lector, fd_bloqueo)) {
+            // Cambios de la transacción en curso hasta su "C" (líneas con '\n').
+            char* transaccion = NULL;
+            size_t largo = 0, capacidad = 0;
+            uint64_t bytes_transaccion = 0;
+            while (leer_linea(lector, linea, sizeof(linea)) > 0) {
+                unsigned long long lsn_anunciado, marca;
+                if (sscanf(linea, "HB|%llu|%llu", &lsn_anunciado, &marca) == 2) {
+                    __atomic_store_n(&metricas->replica_lsn_primario, lsn_anunciado, __ATOMIC_RELAXED);
+                    if (__atomic_load_n(&metricas->replica_lsn_aplicado, __ATOMIC_RELAXED) >= lsn_anunciado) {
+                        __atomic_store_n(&metricas->replica_marca_us, marca, __ATOMIC_RELAXED);
+                    }
+                    continue;
+                }
+                size_t largo_linea = strlen(linea);
+                bytes_transaccion += largo_linea + 1;
+                if (strcmp(linea, "C") == 0) {
+                    flock(fd_bloqueo, LOCK_EX);
+                    if (!aplicar_cambios_replicados(transaccion, largo)) {
+                        fprintf(stderr, "[Réplica] No se pudo aplicar una transacción del primario.\n");
+                    }
+                    flock(fd_bloqueo, LOCK_UN);
+                    __atomic_fetch_add(&metricas->replica_lsn_aplicado, bytes_transaccion, __ATOMIC_RELAXED);
+                    metricas_sumar(&metricas->replica_transacciones, 1);
+                    largo = 0;
+                    bytes_transaccion = 0;
+                    continue;
+                }
+                if (capacidad - largo < largo_linea + 2) {
+                    size_t nueva_capacidad = capacidad ? capacidad * 2 : 64 * TAMANIO_BUFFER;
+                    while (nueva_capacidad - largo < largo_linea + 2) nueva_capacidad *= 2;
+                    char* nuevo = realloc(transaccion, nueva_capacidad);
+                    if (!nuevo) break; // Se reconecta y vuelve a partir de una copia base.
+                    transaccion = nuevo;
+                    capacidad = nueva_capacidad;
+                }
+                memcpy(transaccion + largo, linea, largo_linea);
+                transaccion[largo + largo_linea] = '\n';
+                largo += largo_linea + 1;
+            }
+            free(transaccion);
+        }
+        close(socket_primario);
+        __atomic_store_n(&metricas->replica_conectada, 0, __ATOMIC_RELAXED);
+        printf("[Réplica] Conexión con el primario perdida. Reintentando...\n");
+        fflush(stdout);
+        sleep(1);
+    }
+}
+
+// Cambio de una transacción replicada.
+typedef struct {
+    char tipo;         // 'P' (alta o modificación) o 'D' (baja).
+    long id;
+    long orden;        // Posición del cambio dentro de la transacción.
+    long primer_orden; // Posición del primer cambio del mismo ID.
+    const char* fila;  // Fila completa con '\n' (solo 'P').
+    size_t largo_fila;
+} CambioReplicado;
+
+int comparar_cambios_por_id(const void* a, const void* b) {
+    const CambioReplicado* x = a;
+    const CambioReplicado* y = b;
+    if (x->id != y->id) return x->id < y->id ? -1 : 1;
+    return x->orden < y->orden ? -1 : (x->orden > y->orden);
+}
+
+int comparar_cambios_por_orden(const void* a, const void* b) {
+    const CambioReplicado* x = a;
+    const CambioReplicado* y = b;
+    return x->primer_orden < y->primer_orden ? -1 : (x->primer_orden > y->primer_orden);
+}
+
+// Aplica una transacción del primario. Para cada ID vale su último cambio: las filas
+// nuevas se agregan al final en el orden en que aparecieron y las modificaciones y bajas
+// se resuelven en una sola reescritura del archivo, igual que UPDATE/DELETE en el
+// primario, así el CSV de la réplica queda idéntico. Requiere el bloqueo exclusivo.
+bool aplicar_cambios_replicados(char* texto, size_t largo) {
+    if (!indice_vigente()) construir_indice();
+    long capacidad = 0;
+    for (size_t i = 0; i < largo; i++) capacidad += texto[i] == '\n';
+    CambioReplicado* cambios = malloc((capacidad + 1) * sizeof(CambioReplicado));
+    if (!cambios) return false;
+
+    // Separa los cambios. "R|" reinicia la base y anula todo lo anterior.
+    const char* cabecera = NULL;
+    size_t largo_cabecera = 0;
+    long cantidad = 0;
+    size_t posicion = 0;
+    while (posicion < largo) {
+        char* linea = texto + posicion;
+        char* fin = memchr(linea, '\n', largo - posicion);
+        size_t largo_linea = (size_t)(fin - linea) + 1;
+        posicion += largo_linea;
+        if (largo_linea < 3 || linea[1] != '|') continue;
+        if (linea[0] == 'R') {
+            cabecera = linea + 2;
+            largo_cabecera = largo_linea - 2;
+            cantidad = 0;
+        } else if ((linea[0] == 'P' || linea[0] == 'D') && sscanf(linea + 2, "%ld", &cambios[cantidad].id) == 1) {
+            cambios[cantidad].tipo = linea[0];
+            cambios[cantidad].orden = cantidad;
+            cambios[cantidad].fila = linea + 2;
+            cambios[cantidad].largo_fila = largo_linea - 2;
+            cantidad++;
+        }
+    }
+
+    bool ok = true;
+    if (cabecera) {
+        FILE* temporal = fopen(NOMBRE_ARCHIVO_TEMP, "w");
+        ok = temporal && fwrite(cabecera, 1, largo_cabecera, temporal) == largo_cabecera;
+        if (temporal && fclose(temporal) != 0) ok = false;
+        ok = ok && reemplazar_base_de_datos();
+        if (ok) vaciar_indice();
+    }
+
+    // Deja solo el último cambio de cada ID, recordando dónde apareció el primero.
+    qsort(cambios, cantidad, sizeof(CambioReplicado), comparar_cambios_por_id);
+    long finales = 0;
+    for (long i = 0; i < cantidad; i++) {
+        if (finales > 0 && cambios[finales - 1].id == cambios[i].id) {
+            long primer_orden = cambios[finales - 1].primer_orden;
+            cambios[finales - 1] = cambios[i];
+            cambios[finales - 1].primer_orden = primer_orden;
+        } else {
+            cambios[finales] = cambios[i];
+            cambios[finales].primer_orden = cambios[i].orden;
+            finales++;
+        }
+    }
+
+    // Separa las altas (IDs que la réplica no tiene) del resto.
+    CambioReplicado* altas = malloc((finales + 1) * sizeof(CambioReplicado));
+    long cantidad_altas = 0;
+    bool reescribir = false;
+    for (long i = 0; ok && altas && i < finales; i++) {
+        if (indice_buscar(cambios[i].id) != 0) reescribir = true;
+        else if (cambios[i].tipo == 'P') altas[cantidad_altas++] = cambios[i];
+    }
+    if (!altas) ok = false;
+    if (ok) qsort(altas, cantidad_altas, sizeof(CambioReplicado), comparar_cambios_por_orden);
+
+    if (ok && reescribir) {
+        // Reescribe el archivo aplicando modificaciones y bajas, y agrega las altas al final.
+        FILE* original = fopen(NOMBRE_ARCHIVO_BD, "r");
+        FILE* temporal = fopen(NOMBRE_ARCHIVO_TEMP, "w");
+        ok = original && temporal;
+        char linea[TAMANIO_BUFFER];
+        off_t escrito = 0;
+        if (ok && fgets(linea, sizeof(linea), original)) {
+            fputs(linea, temporal);
+            escrito = strlen(linea);
+        }
+        while (ok && fgets(linea, sizeof(linea), original)) {
+            CambioReplicado clave = { .id = 0 };
+            CambioReplicado* cambio = NULL;
+            if (sscanf(linea, "%ld,", &clave.id) == 1) {
+                // Busca el cambio final del ID (único tras la compactación).
+                long desde = 0, hasta = finales - 1;
+                while (desde <= hasta && !cambio) {
+                    long medio = (desde + hasta) / 2;
+                    if (cambios[medio].id == clave.id) cambio = &cambios[medio];
+                    else if (cambios[medio].id < clave.id) desde = medio + 1;
+                    else hasta = medio - 1;
+                }
+            }
+            if (cambio && cambio->tipo == 'D') continue;
+            const char* fila = cambio ? cambio->fila : linea;
+            size_t largo_fila = cambio ? cambio->largo_fila : strlen(linea);
+            if (cambio || sscanf(linea, "%ld,", &clave.id) == 1) indice_registrar(clave.id, escrito);
+            fwrite(fila, 1, largo_fila, temporal);
+            escrito += largo_fila;
+        }
+        for (long i = 0; ok && i < cantidad_altas; i++) {
+            indice_registrar(altas[i].id, escrito);
+            fwrite(altas[i].fila, 1, altas[i].largo_fila, temporal);
+            escrito += altas[i].largo_fila;
+        }
+        if (original) {
+            metricas_sumar(&metricas->bytes_leidos, ftell(original));
+            fclose(original);
+        }
+        if (temporal && fclose(temporal) != 0) ok = false;
+        metricas_sumar(&metricas->bytes_escritos, escrito);
+        ok = ok && reemplazar_base_de_datos();
+        if (ok) {
+            for (long i = 0; i < finales; i++) {
+                if (cambios[i].tipo == 'D') indice_eliminar(cambios[i].id);
+            }
+        } else {
+            remove(NOMBRE_ARCHIVO_TEMP);
+            construir_indice();
+        }
+    } else if (ok && cantidad_altas > 0) {
+        // Solo altas: un append, como ADD y BULK ADD en el primario.
+        FILE* archivo = fopen(NOMBRE_ARCHIVO_BD, "a");
+        off_t base = 0;
+        if (archivo && fseeko(archivo, 0, SEEK_END) == 0) base = ftello(archivo);
+        ok = archivo != NULL;
+        for (long i = 0; ok && i < cantidad_altas; i++) {
+            ok = fwrite(altas[i].fila, 1, altas[i].largo_fila, archivo) == altas[i].largo_fila;
+            indice_registrar(altas[i].id, base);
+            base += altas[i].largo_fila;
+        }
+        if (archivo && fclose(archivo) != 0) ok = false;
+        if (!ok) construir_indice();
+    }
+    indice_marcar_vigente();
+    free(altas);
+    free(cambios);
+    return ok;
+}
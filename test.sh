@@ -4,12 +4,32 @@
 GENERADORES=10
 REGISTROS=50000
 EJECUTABLE="generador"
+PUERTO_PRIMARIO=9410
+PUERTO_REPLICACION=9411
+PUERTO_REPLICA=9412
+
+# Espera a que haya un servidor escuchando en el puerto indicado.
+esperar_puerto() {
+    for _ in $(seq 1 100); do
+        (exec 4<> "/dev/tcp/127.0.0.1/$1") 2>/dev/null && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+limpiar_replicacion() {
+    exec 5>&- 6>&- 2>/dev/null
+    [ -n "$PID_PRIMARIO" ] && kill "$PID_PRIMARIO" 2>/dev/null
+    [ -n "$PID_REPLICA" ] && kill "$PID_REPLICA" 2>/dev/null
+    rm -f primario.* replica.* prueba_lote.txt
+}
+trap limpiar_replicacion EXIT
 
 echo "========================================="
 echo "== SCRIPT DE PRUEBA Y VALIDACIÓN =="
 echo "========================================="
 
-echo -e "\n[1/4] Compilando el proyecto..."
+echo -e "\n[1/5] Compilando el proyecto..."
 make clean > /dev/null
 make
 if [ $? -ne 0 ]; then
@@ -18,7 +38,7 @@ if [ $? -ne 0 ]; then
 fi
 echo "Compilación exitosa."
 
-echo -e "\n[2/4] Ejecutando con $GENERADORES procesos y $REGISTROS registros..."
+echo -e "\n[2/5] Ejecutando con $GENERADORES procesos y $REGISTROS registros..."
 time ./$EJECUTABLE $GENERADORES $REGISTROS
 if [ $? -ne 0 ]; then
     echo "Error: La ejecución del programa falló."
@@ -26,8 +46,74 @@ if [ $? -ne 0 ]; then
 fi
 echo "Ejecución finalizada."
 
-echo -e "\n[3/4] Validando el archivo de salida..."
-awk -f validate.awk output.csv
+echo -e "\n[3/5] Validando el archivo de salida con verificar_ids.awk..."
+awk -f verificar_ids.awk output.csv
+
+echo -e "\n[4/5] Validando el archivo de salida con validador..."
+./validador output.csv
+if [ $? -ne 0 ]; then
+    echo "Error: La validación falló."
+    exit 1
+fi
+
+echo -e "\n[5/5] Replicando: primario y réplica deben quedar idénticos..."
+rm -f primario.* replica.*
+cp output.csv primario.csv
+mkfifo primario.stdin replica.stdin
+./servidor $PUERTO_PRIMARIO 4 4 --bd primario.csv --replicacion $PUERTO_REPLICACION < primario.stdin > /dev/null &
+PID_PRIMARIO=$!
+exec 5> primario.stdin
+esperar_puerto $PUERTO_REPLICACION
+./servidor $PUERTO_REPLICA 4 4 --bd replica.csv --replica-of 127.0.0.1:$PUERTO_REPLICACION < replica.stdin > /dev/null &
+PID_REPLICA=$!
+exec 6> replica.stdin
+if ! esperar_puerto $PUERTO_PRIMARIO || ! esperar_puerto $PUERTO_REPLICA; then
+    echo "Error: Los servidores no respondieron."
+    exit 1
+fi
+
+cat > prueba_lote.txt <<'FIN'
+BEGIN TRANSACTION
+ADD Teclado,5,10.50
+UPDATE 3 2 77
+UPDATE 4 1 Monitor
+DELETE 10
+BULK ADD
+Mouse,1,2.00
+Laptop,2,999.99
+END
+COMMIT TRANSACTION
+BEGIN TRANSACTION
+DELETE 0
+ADD Impresora,3,150.00
+COMMIT TRANSACTION
+FIN
+if ! ./cliente 127.0.0.1 $PUERTO_PRIMARIO --batch prueba_lote.txt; then
+    echo "Error: El lote de escrituras falló."
+    exit 1
+fi
+
+# La réplica aplica los cambios de forma asíncrona: se le da un margen para alcanzar al primario.
+iguales=0
+for _ in $(seq 1 50); do
+    if cmp -s primario.csv replica.csv; then
+        iguales=1
+        break
+    fi
+    sleep 0.2
+done
+echo "CLOSE" >&5
+echo "CLOSE" >&6
+exec 5>&- 6>&-
+wait $PID_PRIMARIO $PID_REPLICA
+PID_PRIMARIO=""
+PID_REPLICA=""
+if [ "$iguales" -ne 1 ]; then
+    cmp primario.csv replica.csv
+    echo "Error: La réplica no coincide con el primario."
+    exit 1
+fi
+echo "La réplica coincide con el primario."
 
 echo -e "\n========================================="
 echo "== Prueba completada =="
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Validador de IDs del CSV generado. Da los mismos veredictos que verificar_ids.awk,
+// pero recorre el archivo mapeado en memoria con varios hilos y registra los IDs en un
+// mapa de bits compartido (un bit por ID) en lugar de un arreglo asociativo. El mapa se
+// dimensiona con la cantidad de líneas y no con el ID máximo, así un ID basura no lo
+// agranda: los IDs desde el doble de líneas se informan como líneas mal formadas.
+
+#define MAX_HILOS 256
+#define MAX_REPORTES 20       // Duplicados / líneas mal formadas que se muestran por hilo
+#define MAX_RANGOS_FALTANTES 20 // Rangos de IDs faltantes que se muestran
+#define MAX_DIGITOS_ID 18     // Evita desbordar un long al convertir el ID
+
+// Porción del archivo que procesa cada hilo. Empieza al comienzo de una línea y termina
+// justo después de un '\n' (o al final del archivo).
+typedef struct {
+    const char* inicio;
+    const char* fin;
+
+    // Primera pasada.
+    long lineas;          // Líneas de la porción (incluidas las mal formadas)
+    long mal_formadas;
+    long mal_formadas_linea[MAX_REPORTES]; // Número de línea dentro de la porción (desde 0)
+    const char* mal_formadas_texto[MAX_REPORTES];
+
+    // Segunda pasada.
+    long max_id;
+    long duplicados;
+    long duplicados_id[MAX_REPORTES];
+    long fuera_de_rango;  // IDs >= limite_ids
+    long fuera_de_rango_linea[MAX_REPORTES];
+    const char* fuera_de_rango_texto[MAX_REPORTES];
+} Porcion;
+
+// Mapa de bits compartido por los hilos de la segunda pasada.
+uint64_t* mapa_ids = NULL;
+long limite_ids = 0; // Los IDs válidos van de 0 a limite_ids - 1.
+
+void mostrar_ayuda(const char* nombre_programa) {
+    fprintf(stderr, "Uso: %s [archivo_csv] [-t hilos]\n", nombre_programa);
+    fprintf(stderr, "  archivo_csv  Archivo a validar (por defecto output.csv)\n");
+    fprintf(stderr, "  -t hilos     Hilos de validación (por defecto, uno por CPU)\n");
+    fprintf(stderr, "Ejemplo: %s output.csv -t 8\n", nombre_programa);
+}
+
+// Interpreta el ID al comienzo de una línea: dígitos seguidos de ','. Devuelve -1 si
+// la línea está mal formada.
+static inline long leer_id(const char* linea, const char* fin_linea) {
+    long id = 0;
+    const char* p = linea;
+    while (p < fin_linea && *p >= '0' && *p <= '9') {
+        if (p - linea >= MAX_DIGITOS_ID) return -1;
+        id = id * 10 + (*p - '0');
+        p++;
+    }
+    if (p == linea || p == fin_linea || *p != ',') return -1;
+    return id;
+}
+
+// Primera pasada: cuenta líneas y detecta las mal formadas.
+void* contar_porcion(void* argumento) {
+    Porcion* porcion = argumento;
+    const char* p = porcion->inicio;
+    while (p < porcion->fin) {
+        const char* salto = memchr(p, '\n', porcion->fin - p);
+        const char* fin_linea = salto ? salto : porcion->fin;
+        if (leer_id(p, fin_linea) < 0) {
+            if (porcion->mal_formadas < MAX_REPORTES) {
+                porcion->mal_formadas_linea[porcion->mal_formadas] = porcion->lineas;
+                porcion->mal_formadas_texto[porcion->mal_formadas] = p;
+            }
+            porcion->mal_formadas++;
+        }
+        porcion->lineas++;
+        p = fin_linea + 1;
+    }
+    return NULL;
+}
+
+// Segunda pasada: marca cada ID en el mapa de bits y busca el ID máximo. Si el bit ya
+// estaba encendido, el ID está duplicado (lo detecta el hilo que llega segundo, sin
+// importar el orden).
+void* marcar_porcion(void* argumento) {
+    Porcion* porcion = argumento;
+    const char* p = porcion->inicio;
+    long linea = 0;
+    porcion->max_id = -1;
+    while (p < porcion->fin) {
+        const char* salto = memchr(p, '\n', porcion->fin - p);
+        const char* fin_linea = salto ? salto : porcion->fin;
+        long id = leer_id(p, fin_linea);
+        if (id >= limite_ids) {
+            if (porcion->fuera_de_rango < MAX_REPORTES) {
+                porcion->fuera_de_rango_linea[porcion->fuera_de_rango] = linea;
+                porcion->fuera_de_rango_texto[porcion->fuera_de_rango] = p;
+            }
+            porcion->fuera_de_rango++;
+        } else if (id >= 0) {
+            if (id > porcion->max_id) porcion->max_id = id;
+            uint64_t bit = (uint64_t)1 << (id & 63);
+            uint64_t anterior = __atomic_fetch_or(&mapa_ids[id >> 6], bit, __ATOMIC_RELAXED);
+            if (anterior & bit) {
+                if (porcion->duplicados < MAX_REPORTES) porcion->duplicados_id[porcion->duplicados] = id;
+                porcion->duplicados++;
+            }
+        }
+        linea++;
+        p = fin_linea + 1;
+    }
+    return NULL;
+}
+
+// Ejecuta una pasada con un hilo por porción.
+void ejecutar_pasada(void* (*funcion)(void*), Porcion* porciones, int cantidad) {
+    pthread_t hilos[MAX_HILOS];
+    bool creado[MAX_HILOS];
+    for (int i = 0; i < cantidad; i++) {
+        creado[i] = pthread_create(&hilos[i], NULL, funcion, &porciones[i]) == 0;
+        // Sin hilo disponible, la porción se procesa en este mismo.
+        if (!creado[i]) funcion(&porciones[i]);
+    }
+    for (int i = 0; i < cantidad; i++) {
+        if (creado[i]) pthread_join(hilos[i], NULL);
+    }
+}
+
+// Muestra una línea con problemas, recortada a 60 caracteres.
+void reportar_linea(const char* motivo, long numero, const char* texto, const char* fin) {
+    const char* salto = memchr(texto, '\n', fin - texto);
+    int largo = (int)((salto ? salto : fin) - texto);
+    if (largo > 60) largo = 60;
+    printf("Error: %s %ld -> '%.*s'\n", motivo, numero, largo, texto);
+}
+
+// Recorre el mapa de bits y muestra los rangos de IDs ausentes entre 0 y max_id.
+long reportar_faltantes(long max_id) {
+    long faltantes = 0, rangos = 0;
+    long id = 0;
+    while (id <= max_id) {
+        // Salta palabras completas sin huecos.
+        if ((id & 63) == 0 && id + 63 <= max_id && mapa_ids[id >> 6] == UINT64_MAX) {
+            id += 64;
+            continue;
+        }
+        if (mapa_ids[id >> 6] & ((uint64_t)1 << (id & 63))) {
+            id++;
+            continue;
+        }
+        long desde = id;
+        while (id <= max_id && !(mapa_ids[id >> 6] & ((uint64_t)1 << (id & 63)))) {
+            id++;
+        }
+        faltantes += id - desde;
+        if (rangos++ < MAX_RANGOS_FALTANTES) {
+            if (id - 1 == desde) printf("Error: ID faltante -> %ld\n", desde);
+            else printf("Error: IDs faltantes -> %ld a %ld\n", desde, id - 1);
+        }
+    }
+    if (rangos > MAX_RANGOS_FALTANTES) {
+        printf("... %ld rangos más sin mostrar.\n", rangos - MAX_RANGOS_FALTANTES);
+    }
+    return faltantes;
+}
+
+int main(int argc, char* argv[]) {
+    const char* ruta = "output.csv";
+    long cantidad_hilos = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            cantidad_hilos = atol(argv[++i]);
+            if (cantidad_hilos <= 0) {
+                fprintf(stderr, "Error: La cantidad de hilos debe ser un número positivo.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 || argv[i][0] == '-') {
+            mostrar_ayuda(argv[0]);
+            return 1;
+        } else {
+            ruta = argv[i];
+        }
+    }
+    if (cantidad_hilos < 1) cantidad_hilos = 1;
+    if (cantidad_hilos > MAX_HILOS) cantidad_hilos = MAX_HILOS;
+
+    int fd = open(ruta, O_RDONLY);
+    if (fd < 0) {
+        perror(ruta);
+        return 1;
+    }
+    struct stat estado;
+    if (fstat(fd, &estado) != 0) {
+        perror("fstat");
+        return 1;
+    }
+    size_t tamanio = (size_t)estado.st_size;
+    const char* datos = NULL;
+    if (tamanio > 0) {
+        datos = mmap(NULL, tamanio, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (datos == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        madvise((void*)datos, tamanio, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    printf("--- Iniciando validación de %s ---\n", ruta);
+
+    // Salta la cabecera.
+    const char* inicio = datos;
+    const char* fin = datos + tamanio;
+    if (tamanio > 0) {
+        const char* salto = memchr(datos, '\n', tamanio);
+        inicio = salto ? salto + 1 : fin;
+    }
+
+    // Divide el resto en porciones de tamaño similar, alineadas a fin de línea.
+    Porcion* porciones = calloc((size_t)cantidad_hilos, sizeof(Porcion));
+    if (!porciones) {
+        perror("calloc");
+        return 1;
+    }
+    int cantidad_porciones = 0;
+    size_t tamanio_porcion = (size_t)(fin - inicio) / (size_t)cantidad_hilos + 1;
+    const char* actual = inicio;
+    while (actual < fin && cantidad_porciones < cantidad_hilos) {
+        const char* limite = cantidad_porciones == cantidad_hilos - 1 || (size_t)(fin - actual) <= tamanio_porcion
+                             ? fin : actual + tamanio_porcion;
+        if (limite < fin) {
+            const char* salto = memchr(limite, '\n', fin - limite);
+            limite = salto ? salto + 1 : fin;
+        }
+        porciones[cantidad_porciones].inicio = actual;
+        porciones[cantidad_porciones].fin = limite;
+        cantidad_porciones++;
+        actual = limite;
+    }
+
+    // Primera pasada: cantidad de líneas, necesaria para dimensionar el mapa de bits.
+    ejecutar_pasada(contar_porcion, porciones, cantidad_porciones);
+    long lineas = 0, mal_formadas = 0;
+    long linea_base = 2; // La línea 1 es la cabecera.
+    for (int i = 0; i < cantidad_porciones; i++) {
+        Porcion* porcion = &porciones[i];
+        lineas += porcion->lineas;
+        mal_formadas += porcion->mal_formadas;
+        for (long j = 0; j < porcion->mal_formadas && j < MAX_REPORTES; j++) {
+            reportar_linea("Línea mal formada", linea_base + porcion->mal_formadas_linea[j],
+                           porcion->mal_formadas_texto[j], porcion->fin);
+        }
+        if (porcion->mal_formadas > MAX_REPORTES) {
+            printf("... %ld líneas mal formadas más en esta parte del archivo.\n", porcion->mal_formadas - MAX_REPORTES);
+        }
+        linea_base += porcion->lineas;
+    }
+
+    // Segunda pasada: un bit por ID posible. Un ID algo mayor que la cantidad de líneas se
+    // sigue tratando como ID (los huecos se informan como faltantes); el margen del doble
+    // solo descarta valores que no pueden venir del generador.
+    long max_id = -1, duplicados = 0, faltantes = 0;
+    if (lineas > 0) {
+        limite_ids = 2 * lineas;
+        mapa_ids = calloc((size_t)(limite_ids >> 6) + 1, sizeof(uint64_t));
+        if (!mapa_ids) {
+            fprintf(stderr, "Error: No hay memoria para el mapa de %ld IDs.\n", limite_ids);
+            return 1;
+        }
+        ejecutar_pasada(marcar_porcion, porciones, cantidad_porciones);
+        linea_base = 2;
+        for (int i = 0; i < cantidad_porciones; i++) {
+            Porcion* porcion = &porciones[i];
+            if (porcion->max_id > max_id) max_id = porcion->max_id;
+            for (long j = 0; j < porcion->fuera_de_rango && j < MAX_REPORTES; j++) {
+                reportar_linea("Línea mal formada (ID fuera de rango)", linea_base + porcion->fuera_de_rango_linea[j],
+                               porcion->fuera_de_rango_texto[j], porcion->fin);
+            }
+            if (porcion->fuera_de_rango > MAX_REPORTES) {
+                printf("... %ld IDs fuera de rango más en esta parte del archivo.\n", porcion->fuera_de_rango - MAX_REPORTES);
+            }
+            for (long j = 0; j < porcion->duplicados && j < MAX_REPORTES; j++) {
+                printf("Error: ID duplicado -> %ld\n", porcion->duplicados_id[j]);
+            }
+            if (porcion->duplicados > MAX_REPORTES) {
+                printf("... %ld IDs duplicados más en esta parte del archivo.\n", porcion->duplicados - MAX_REPORTES);
+            }
+            duplicados += porcion->duplicados;
+            mal_formadas += porcion->fuera_de_rango;
+            linea_base += porcion->lineas;
+        }
+    }
+
+    // Veredictos, con los mismos mensajes que verificar_ids.awk.
+    if (duplicados == 0) printf("OK: No se encontraron IDs duplicados.\n");
+    // Como en el script, el total cuenta todas las líneas después de la cabecera.
+    long esperados = max_id + 1;
+    if (lineas == esperados) {
+        printf("OK: Los IDs son correlativos. Total: %ld (ID máx: %ld). \n", lineas, max_id);
+    } else {
+        printf("Error: Faltan IDs. Total: %ld. Se esperaba: %ld. \n", lineas, esperados);
+    }
+    if (max_id >= 0) faltantes = reportar_faltantes(max_id);
+    if (faltantes > 0) printf("IDs faltantes: %ld.\n", faltantes);
+    if (duplicados > 0) printf("IDs duplicados: %ld.\n", duplicados);
+    if (mal_formadas > 0) printf("Error: %ld líneas mal formadas.\n", mal_formadas);
+    printf("--- Fin de la validación ---\n");
+
+    free(mapa_ids);
+    free(porciones);
+    if (tamanio > 0) munmap((void*)datos, tamanio);
+    return (duplicados > 0 || faltantes > 0 || mal_formadas > 0 || lineas != esperados) ? 1 : 0;
+}